@@ -0,0 +1,385 @@
+#include "allocator.h"
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace {
+
+constexpr size_t kSlabSize = 64 * 1024;
+constexpr size_t kGranularity = 16;
+constexpr size_t kSizeClasses = 16;  // blocks of up to 256 bytes
+
+struct FreeBlock {
+    FreeBlock* next;
+};
+
+class Pool;
+
+// Slabs are aligned to their size, so the slab of a block is found by masking
+// its address. Only the owning pool touches a slab, except for remote_free:
+// blocks freed by other threads are pushed there and reclaimed by the owner.
+// Slabs of exited threads have no owner, see SharedSlabs.
+struct alignas(kGranularity) Slab {
+    std::atomic<Pool*> owner;
+    size_t live = 0;
+    char* bump;
+    FreeBlock* free_list = nullptr;
+    std::atomic<FreeBlock*> remote_free = nullptr;
+    bool available = true;
+
+    char* End() {
+        return reinterpret_cast<char*>(this) + kSlabSize;
+    }
+};
+
+Slab* SlabOf(void* ptr) {
+    return reinterpret_cast<Slab*>(reinterpret_cast<uintptr_t>(ptr) & ~(kSlabSize - 1));
+}
+
+void PushRemoteFree(Slab* slab, void* ptr) {
+    auto block = static_cast<FreeBlock*>(ptr);
+    block->next = slab->remote_free.load(std::memory_order_relaxed);
+    while (!slab->remote_free.compare_exchange_weak(
+        block->next, block, std::memory_order_release, std::memory_order_relaxed)) {
+    }
+}
+
+// Moves the blocks freed by other threads to the free list of slab; returns
+// whether there were any. Called by the owner of slab, or under the lock of
+// SharedSlabs if it has none.
+bool ReclaimSlab(Slab* slab) {
+    FreeBlock* block = slab->remote_free.exchange(nullptr, std::memory_order_acquire);
+    bool reclaimed = (block != nullptr);
+    while (block) {
+        FreeBlock* next = block->next;
+        block->next = slab->free_list;
+        slab->free_list = block;
+        --slab->live;
+        block = next;
+    }
+    return reclaimed;
+}
+
+void FreeSlab(Slab* slab) {
+    slab->~Slab();
+    std::free(slab);
+}
+
+// Slabs left behind by exited threads. Empty ones are reused by any pool
+// that needs a new slab; the others are adopted by the next pool of their
+// size class that runs out of room, and freed by TrimObjectPools once their
+// objects are gone.
+struct SharedSlabs {
+    std::mutex mutex;
+    std::vector<Slab*> empty;
+    std::vector<Slab*> orphaned[kSizeClasses];
+};
+
+// Never destroyed: threads may exit while static objects are destroyed.
+SharedSlabs& GetSharedSlabs() {
+    static SharedSlabs* shared = new SharedSlabs();
+    return *shared;
+}
+
+class Pool {
+public:
+    void* Allocate(size_t block_size) {
+        ++allocations_;
+        if (void* block = TryAllocate(block_size)) {
+            return block;
+        }
+        if (ReclaimRemoteFrees() || AdoptSlabs(block_size)) {
+            if (void* block = TryAllocate(block_size)) {
+                return block;
+            }
+        }
+        Slab* slab = NewSlab();
+        void* block = slab->bump;
+        slab->bump += block_size;
+        ++slab->live;
+        return block;
+    }
+
+    // Frees ptr, a block of a slab of this pool.
+    void Deallocate(void* ptr) {
+        Slab* slab = SlabOf(ptr);
+        auto block = static_cast<FreeBlock*>(ptr);
+        block->next = slab->free_list;
+        slab->free_list = block;
+        --slab->live;
+        MakeAvailable(slab);
+    }
+
+    size_t Trim() {
+        ReclaimRemoteFrees();
+        size_t released = 0;
+        std::vector<Slab*> kept;
+        for (Slab* slab : slabs_) {
+            if (slab->live == 0) {
+                FreeSlab(slab);
+                released += kSlabSize;
+            } else {
+                kept.push_back(slab);
+            }
+        }
+        slabs_ = std::move(kept);
+        available_.clear();
+        for (Slab* slab : slabs_) {
+            if (slab->available) {
+                available_.push_back(slab);
+            }
+        }
+        return released;
+    }
+
+    // Hands all slabs over to SharedSlabs, when the thread exits.
+    void Release(size_t size_class) {
+        ReclaimRemoteFrees();
+        SharedSlabs& shared = GetSharedSlabs();
+        std::lock_guard lock(shared.mutex);
+        for (Slab* slab : slabs_) {
+            slab->owner.store(nullptr, std::memory_order_relaxed);
+            if (slab->live == 0) {
+                shared.empty.push_back(slab);
+            } else {
+                shared.orphaned[size_class].push_back(slab);
+            }
+        }
+        slabs_.clear();
+        available_.clear();
+    }
+
+    size_t GetAllocations() const {
+        return allocations_;
+    }
+
+    void AddStats(ObjectPoolStats* stats) const {
+        stats->slabs += slabs_.size();
+        stats->slab_allocations += slab_allocations_;
+        stats->allocations += allocations_;
+        for (Slab* slab : slabs_) {
+            stats->live_blocks += slab->live;
+        }
+    }
+
+private:
+    void* TryAllocate(size_t block_size) {
+        while (!available_.empty()) {
+            Slab* slab = available_.back();
+            if (slab->free_list) {
+                FreeBlock* block = slab->free_list;
+                slab->free_list = block->next;
+                ++slab->live;
+                return block;
+            }
+            if (slab->bump + block_size <= slab->End()) {
+                void* block = slab->bump;
+                slab->bump += block_size;
+                ++slab->live;
+                return block;
+            }
+            slab->available = false;
+            available_.pop_back();
+        }
+        return nullptr;
+    }
+
+    void MakeAvailable(Slab* slab) {
+        if (!slab->available) {
+            slab->available = true;
+            available_.push_back(slab);
+        }
+    }
+
+    // Moves blocks freed by other threads to the free lists of their slabs;
+    // returns whether there were any.
+    bool ReclaimRemoteFrees() {
+        bool reclaimed = false;
+        for (Slab* slab : slabs_) {
+            reclaimed |= ReclaimSlab(slab);
+            if (slab->free_list) {
+                MakeAvailable(slab);
+            }
+        }
+        return reclaimed;
+    }
+
+    // Takes over the slabs of this size class left by exited threads; returns
+    // whether there were any.
+    bool AdoptSlabs(size_t block_size) {
+        SharedSlabs& shared = GetSharedSlabs();
+        std::lock_guard lock(shared.mutex);
+        std::vector<Slab*>& orphaned = shared.orphaned[block_size / kGranularity - 1];
+        for (Slab* slab : orphaned) {
+            slab->owner.store(this, std::memory_order_relaxed);
+            ReclaimSlab(slab);
+            slabs_.push_back(slab);
+            slab->available = true;
+            available_.push_back(slab);
+        }
+        bool adopted = !orphaned.empty();
+        orphaned.clear();
+        return adopted;
+    }
+
+    // Reuses an empty slab of an exited thread if there is one.
+    Slab* NewSlab() {
+        void* memory = nullptr;
+        {
+            SharedSlabs& shared = GetSharedSlabs();
+            std::lock_guard lock(shared.mutex);
+            if (!shared.empty.empty()) {
+                memory = shared.empty.back();
+                shared.empty.pop_back();
+                static_cast<Slab*>(memory)->~Slab();
+            }
+        }
+        if (!memory) {
+            memory = std::aligned_alloc(kSlabSize, kSlabSize);
+            if (!memory) {
+                throw std::bad_alloc();
+            }
+        }
+        Slab* slab = new (memory) Slab();
+        slab->owner.store(this, std::memory_order_relaxed);
+        slab->bump = reinterpret_cast<char*>(slab) + sizeof(Slab);
+        slabs_.push_back(slab);
+        available_.push_back(slab);
+        ++slab_allocations_;
+        return slab;
+    }
+
+    std::vector<Slab*> slabs_;
+    // Slabs that may have room; full ones are dropped lazily on allocation.
+    std::vector<Slab*> available_;
+    size_t slab_allocations_ = 0;
+    size_t allocations_ = 0;
+};
+
+// Every thread allocates from its own pools, so allocation never locks.
+thread_local Pool* current_pools = nullptr;
+
+// Pooled objects may outlive the thread that made them, so when it exits its
+// slabs are handed over to SharedSlabs rather than freed.
+struct PoolsReleaser {
+    ~PoolsReleaser() {
+        for (size_t i = 0; i < kSizeClasses; ++i) {
+            current_pools[i].Release(i);
+        }
+        delete[] current_pools;
+        current_pools = nullptr;
+    }
+};
+
+thread_local PoolsReleaser pools_releaser;
+
+// Pools made by destructors that run after the releaser are never released.
+Pool* GetPools() {
+    if (!current_pools) {
+        current_pools = new Pool[kSizeClasses];
+        // Constructs the releaser, so it is destroyed when the thread exits.
+        static_cast<void>(&pools_releaser);
+    }
+    return current_pools;
+}
+
+// Frees the slabs of exited threads that have no live objects left.
+size_t TrimSharedSlabs() {
+    SharedSlabs& shared = GetSharedSlabs();
+    std::lock_guard lock(shared.mutex);
+    size_t released = 0;
+    for (std::vector<Slab*>& orphaned : shared.orphaned) {
+        std::vector<Slab*> kept;
+        for (Slab* slab : orphaned) {
+            ReclaimSlab(slab);
+            if (slab->live == 0) {
+                FreeSlab(slab);
+                released += kSlabSize;
+            } else {
+                kept.push_back(slab);
+            }
+        }
+        orphaned = std::move(kept);
+    }
+    for (Slab* slab : shared.empty) {
+        FreeSlab(slab);
+        released += kSlabSize;
+    }
+    shared.empty.clear();
+    return released;
+}
+
+thread_local ObjectMemoryCounters memory_counters;
+
+size_t SizeClass(size_t size) {
+    return (size + kGranularity - 1) / kGranularity - 1;
+}
+
+}  // namespace
+
+void* AllocateObjectMemory(size_t size) {
+    memory_counters.allocated_bytes += size;
+    size_t size_class = SizeClass(size);
+    if (size_class >= kSizeClasses) {
+        return ::operator new(size);
+    }
+    return GetPools()[size_class].Allocate((size_class + 1) * kGranularity);
+}
+
+void DeallocateObjectMemory(void* ptr, size_t size) {
+    memory_counters.freed_bytes += size;
+    size_t size_class = SizeClass(size);
+    if (size_class >= kSizeClasses) {
+        ::operator delete(ptr);
+        return;
+    }
+    // Only the owner touches the free lists of a slab; this thread may have
+    // no pools anymore if it is exiting.
+    Slab* slab = SlabOf(ptr);
+    Pool* pool = (current_pools ? &current_pools[size_class] : nullptr);
+    if (pool && slab->owner.load(std::memory_order_relaxed) == pool) {
+        pool->Deallocate(ptr);
+    } else {
+        PushRemoteFree(slab, ptr);
+    }
+}
+
+size_t TrimObjectPools() {
+    size_t released = 0;
+    for (size_t i = 0; i < kSizeClasses; ++i) {
+        released += GetPools()[i].Trim();
+    }
+    return released + TrimSharedSlabs();
+}
+
+ObjectPoolStats GetObjectPoolStats() {
+    ObjectPoolStats stats;
+    for (size_t i = 0; i < kSizeClasses; ++i) {
+        GetPools()[i].AddStats(&stats);
+    }
+    return stats;
+}
+
+size_t GetObjectAllocations() {
+    size_t allocations = 0;
+    for (size_t i = 0; i < kSizeClasses; ++i) {
+        allocations += GetPools()[i].GetAllocations();
+    }
+    return allocations;
+}
+
+ObjectMemoryCounters GetObjectMemoryCounters() {
+    return memory_counters;
+}
+
+void OwnedMemory::Set(size_t bytes) {
+    if (bytes > bytes_) {
+        memory_counters.allocated_bytes += bytes - bytes_;
+    } else {
+        memory_counters.freed_bytes += bytes_ - bytes;
+    }
+    bytes_ = bytes;
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+// Size-class pool allocator for interpreter objects.
+//
+// Memory is carved out of 64 KiB slabs, one list of slabs per 16-byte size
+// class. A fresh slab is handed out by bumping a pointer, freed blocks go to
+// the free list of their slab, so objects of one size allocated together end
+// up next to each other. Requests larger than the biggest size class fall
+// back to operator new.
+
+void* AllocateObjectMemory(size_t size);
+void DeallocateObjectMemory(void* ptr, size_t size);
+
+// Returns slabs without live objects to the system, those of the calling
+// thread and those left by exited threads; returns the number of released
+// bytes.
+size_t TrimObjectPools();
+
+// Counters of the pools of the calling thread.
+struct ObjectPoolStats {
+    size_t slabs = 0;
+    size_t live_blocks = 0;
+    size_t slab_allocations = 0;
+    // Blocks handed out since the thread started.
+    size_t allocations = 0;
+};
+
+ObjectPoolStats GetObjectPoolStats();
+
+// Same as GetObjectPoolStats().allocations, without walking the slabs.
+size_t GetObjectAllocations();
+
+// Bytes of object memory allocated and freed by the calling thread, pooled
+// or not.
+struct ObjectMemoryCounters {
+    size_t allocated_bytes = 0;
+    size_t freed_bytes = 0;
+};
+
+ObjectMemoryCounters GetObjectMemoryCounters();
+
+// Memory an object owns outside its own block, such as the elements of a
+// vector. It is counted as object memory of the thread that sets it, so that
+// memory limits see it; the owner updates it as that memory changes.
+class OwnedMemory {
+public:
+    OwnedMemory() = default;
+    explicit OwnedMemory(size_t bytes) {
+        Set(bytes);
+    }
+    ~OwnedMemory() {
+        Set(0);
+    }
+
+    OwnedMemory(const OwnedMemory&) = delete;
+    OwnedMemory& operator=(const OwnedMemory&) = delete;
+
+    void Set(size_t bytes);
+
+private:
+    size_t bytes_ = 0;
+};
+
+template <class T>
+class PoolAllocator {
+public:
+    using value_type = T;
+
+    PoolAllocator() = default;
+    template <class U>
+    PoolAllocator(const PoolAllocator<U>&) {
+    }
+
+    T* allocate(size_t n) {
+        return static_cast<T*>(AllocateObjectMemory(n * sizeof(T)));
+    }
+
+    void deallocate(T* ptr, size_t n) {
+        DeallocateObjectMemory(ptr, n * sizeof(T));
+    }
+
+    template <class U>
+    bool operator==(const PoolAllocator<U>&) const {
+        return true;
+    }
+};
+
+// Pooled replacement for std::make_shared: the object and its control block
+// share one block from the pool.
+template <class T, class... Args>
+std::shared_ptr<T> MakeObject(Args&&... args) {
+    return std::allocate_shared<T>(PoolAllocator<T>(), std::forward<Args>(args)...);
+}
@@ -0,0 +1,589 @@
+#include "analyzer.h"
+#include "bytecode.h"
+#include "folding.h"
+#include "functions.h"
+#include "memoize.h"
+#include "scope.h"
+#include <unordered_map>
+
+// Tail calls
+
+// Returned by a call in tail position after it stored its callee and
+// arguments as the pending tail call of the context.
+static const ObjectPtr kTailCallMarker = std::make_shared<Function>();
+
+std::shared_ptr<Frame> MakeFrame(const Lambda& lambda, std::vector<ObjectPtr> args) {
+    const LambdaNode& code = *lambda.GetCode();
+    if (args.size() != code.GetParamsCount()) {
+        throw RuntimeError("Expected " + std::to_string(code.GetParamsCount()) +
+                           " arguments in lambda, got " + std::to_string(args.size()));
+    }
+    args.resize(code.GetFrameSize(), Unbound());
+    return MakeObject<Frame>(std::move(args), lambda.GetFrame());
+}
+
+ObjectPtr CallLambda(Context* context, std::shared_ptr<Lambda> lambda,
+                     std::vector<ObjectPtr> args) {
+    std::shared_ptr<Frame> prev_frame = context->GetCurrentFrame();
+    Profiler* profiler = context->GetProfiler();
+    size_t profiler_depth = profiler ? profiler->GetDepth() : 0;
+    // Tail calls loop here, so they do not nest.
+    context->EnterCall();
+    ObjectPtr res;
+    try {
+        do {
+            if (profiler) {
+                profiler->Enter(lambda->GetName());
+            }
+            context->SetCurrentFrame(MakeFrame(*lambda, std::move(args)));
+            context->MaybeCollectGarbage();
+            res = lambda->GetCode()->ExecuteBody(context);
+            if (profiler) {
+                profiler->Leave();
+            }
+            if (res == kTailCallMarker) {
+                TailCall& pending = context->GetPendingTailCall();
+                lambda = std::move(pending.lambda);
+                args = std::move(pending.args);
+            }
+        } while (res == kTailCallMarker);
+    } catch (...) {
+        if (profiler) {
+            profiler->Unwind(profiler_depth);
+        }
+        context->SetCurrentFrame(prev_frame);
+        context->LeaveCall();
+        throw;
+    }
+    context->SetCurrentFrame(prev_frame);
+    context->LeaveCall();
+    return res;
+}
+
+ObjectPtr ApplyFunction(Context* context, const ObjectPtr& function,
+                        const std::vector<ObjectPtr>& args) {
+    // The empty list is null, and builtins pass callbacks through unchecked.
+    if (!function) {
+        throw RuntimeError("Object is not a function");
+    }
+    Profiler* profiler = context->GetProfiler();
+    if (!profiler || !Is<Function>(function) || Is<Lambda>(function)) {
+        return function->Apply(context, args);
+    }
+    size_t profiler_depth = profiler->GetDepth();
+    profiler->Enter(Cast<Function>(function)->GetName());
+    ObjectPtr res;
+    try {
+        res = function->Apply(context, args);
+    } catch (...) {
+        profiler->Unwind(profiler_depth);
+        throw;
+    }
+    profiler->Leave();
+    return res;
+}
+
+// Nodes
+
+ObjectPtr ConstantNode::Execute(Context*) {
+    return value_;
+}
+
+const ObjectPtr* ConstantNode::GetConstantValue() const {
+    return &value_;
+}
+
+ObjectPtr FoldedNode::Execute(Context* context) {
+    if (context->GetGlobals()->AreFoldedBuiltinsRedefined()) {
+        return fallback_->Execute(context);
+    }
+    return optimized_->Execute(context);
+}
+
+void FoldedNode::MarkTailPosition() {
+    optimized_->MarkTailPosition();
+    fallback_->MarkTailPosition();
+}
+
+const ObjectPtr* FoldedNode::GetConstantValue() const {
+    return optimized_->GetConstantValue();
+}
+
+ObjectPtr InvalidNode::Execute(Context*) {
+    throw RuntimeError(message_);
+}
+
+ObjectPtr LocalVariableNode::Execute(Context* context) {
+    return GetLocal(context->GetCurrentFrame().get(), address_);
+}
+
+ObjectPtr GlobalVariableNode::Execute(Context* context) {
+    return cache_.Get(*context->GetGlobals(), name_);
+}
+
+ObjectPtr DefineNode::Execute(Context* context) {
+    ObjectPtr value = value_->Execute(context);
+    if (local_) {
+        context->GetCurrentFrame()->Lookup(0, local_->slot) = std::move(value);
+    } else {
+        context->GetGlobals()->Define(name_, std::move(value));
+    }
+    return nullptr;
+}
+
+ObjectPtr SetNode::Execute(Context* context) {
+    ObjectPtr value = value_->Execute(context);
+    if (local_) {
+        SetLocal(context->GetCurrentFrame().get(), *local_, std::move(value));
+    } else {
+        context->GetGlobals()->Set(name_, std::move(value));
+    }
+    return nullptr;
+}
+
+void IfNode::MarkTailPosition() {
+    then_branch_->MarkTailPosition();
+    if (else_branch_) {
+        else_branch_->MarkTailPosition();
+    }
+}
+
+ObjectPtr IfNode::Execute(Context* context) {
+    if (!IsFalse(condition_->Execute(context))) {
+        return then_branch_->Execute(context);
+    } else if (!else_branch_) {
+        return nullptr;
+    } else {
+        return else_branch_->Execute(context);
+    }
+}
+
+void AndNode::MarkTailPosition() {
+    if (!operands_.empty()) {
+        operands_.back()->MarkTailPosition();
+    }
+}
+
+ObjectPtr AndNode::Execute(Context* context) {
+    ObjectPtr res = GetBoolean(true);
+    for (auto& operand : operands_) {
+        res = operand->Execute(context);
+        if (IsFalse(res)) {
+            return res;
+        }
+    }
+    return res;
+}
+
+void OrNode::MarkTailPosition() {
+    if (!operands_.empty()) {
+        operands_.back()->MarkTailPosition();
+    }
+}
+
+ObjectPtr OrNode::Execute(Context* context) {
+    ObjectPtr res = GetBoolean(false);
+    for (auto& operand : operands_) {
+        res = operand->Execute(context);
+        if (!IsFalse(res)) {
+            return res;
+        }
+    }
+    return res;
+}
+
+LambdaNode::LambdaNode(size_t params_count, size_t frame_size, std::vector<NodePtr> body)
+    : params_count_(params_count), frame_size_(frame_size), body_(std::move(body)) {
+    if (!body_.empty()) {
+        body_.back()->MarkTailPosition();
+    }
+}
+
+ObjectPtr LambdaNode::Execute(Context* context) {
+    return MakeObject<Lambda>(shared_from_this(), context->GetCurrentFrame());
+}
+
+size_t LambdaNode::GetParamsCount() const {
+    return params_count_;
+}
+
+size_t LambdaNode::GetFrameSize() const {
+    return frame_size_;
+}
+
+const Symbol* LambdaNode::GetName() const {
+    return name_;
+}
+
+void LambdaNode::MarkDefinedAs(const Symbol* name) {
+    name_ = name;
+}
+
+ObjectPtr LambdaNode::ExecuteBody(Context* context) const {
+    ObjectPtr res;
+    for (auto& expression : body_) {
+        res = expression->Execute(context);
+    }
+    return res;
+}
+
+void CallNode::MarkTailPosition() {
+    tail_ = true;
+}
+
+ObjectPtr CallNode::Execute(Context* context) {
+    context->CountStep();
+    ObjectPtr function = function_->Execute(context);
+    if (!function) {
+        throw RuntimeError("Object is not a function");
+    }
+    std::vector<ObjectPtr> args;
+    args.reserve(args_.size());
+    for (auto& arg : args_) {
+        args.push_back(arg->Execute(context));
+    }
+    if (tail_ && Is<Lambda>(function)) {
+        context->GetPendingTailCall() = TailCall{As<Lambda>(function), std::move(args)};
+        return kTailCallMarker;
+    }
+    return ApplyFunction(context, function, args);
+}
+
+// Bytecode generation
+
+void ConstantNode::Emit(Chunk* chunk) {
+    chunk->Emit(OpCode::kConstant, chunk->AddConstant(value_));
+}
+
+void FoldedNode::Emit(Chunk* chunk) {
+    size_t jump_to_fallback = chunk->Emit(OpCode::kJumpIfRedefined);
+    optimized_->Emit(chunk);
+    size_t jump_to_end = chunk->Emit(OpCode::kJump);
+    chunk->Patch(jump_to_fallback, chunk->GetPosition());
+    fallback_->Emit(chunk);
+    chunk->Patch(jump_to_end, chunk->GetPosition());
+}
+
+void InvalidNode::Emit(Chunk* chunk) {
+    chunk->Emit(OpCode::kError, chunk->AddMessage(message_));
+}
+
+void LocalVariableNode::Emit(Chunk* chunk) {
+    chunk->Emit(OpCode::kLoadLocal, chunk->AddLocal(address_));
+}
+
+void GlobalVariableNode::Emit(Chunk* chunk) {
+    chunk->Emit(OpCode::kLoadGlobal, chunk->AddSymbol(name_));
+}
+
+void DefineNode::Emit(Chunk* chunk) {
+    value_->Emit(chunk);
+    if (local_) {
+        chunk->Emit(OpCode::kDefineLocal, local_->slot);
+    } else {
+        chunk->Emit(OpCode::kDefineGlobal, chunk->AddSymbol(name_));
+    }
+}
+
+void SetNode::Emit(Chunk* chunk) {
+    value_->Emit(chunk);
+    if (local_) {
+        chunk->Emit(OpCode::kSetLocal, chunk->AddLocal(*local_));
+    } else {
+        chunk->Emit(OpCode::kSetGlobal, chunk->AddSymbol(name_));
+    }
+}
+
+void IfNode::Emit(Chunk* chunk) {
+    condition_->Emit(chunk);
+    size_t jump_to_else = chunk->Emit(OpCode::kJumpIfFalse);
+    then_branch_->Emit(chunk);
+    size_t jump_to_end = chunk->Emit(OpCode::kJump);
+    chunk->Patch(jump_to_else, chunk->GetPosition());
+    if (else_branch_) {
+        else_branch_->Emit(chunk);
+    } else {
+        chunk->Emit(OpCode::kConstant, chunk->AddConstant(nullptr));
+    }
+    chunk->Patch(jump_to_end, chunk->GetPosition());
+}
+
+static void EmitShortCircuit(Chunk* chunk, const std::vector<NodePtr>& operands, OpCode jump,
+                             bool empty_value) {
+    if (operands.empty()) {
+        chunk->Emit(OpCode::kConstant, chunk->AddConstant(GetBoolean(empty_value)));
+        return;
+    }
+    std::vector<size_t> jumps_to_end;
+    for (size_t i = 0; i + 1 < operands.size(); ++i) {
+        operands[i]->Emit(chunk);
+        jumps_to_end.push_back(chunk->Emit(jump));
+    }
+    operands.back()->Emit(chunk);
+    for (size_t position : jumps_to_end) {
+        chunk->Patch(position, chunk->GetPosition());
+    }
+}
+
+void AndNode::Emit(Chunk* chunk) {
+    EmitShortCircuit(chunk, operands_, OpCode::kJumpIfFalseOrPop, true);
+}
+
+void OrNode::Emit(Chunk* chunk) {
+    EmitShortCircuit(chunk, operands_, OpCode::kJumpIfTrueOrPop, false);
+}
+
+void LambdaNode::Emit(Chunk* chunk) {
+    chunk->Emit(OpCode::kClosure, chunk->AddLambda(shared_from_this()));
+}
+
+const Chunk& LambdaNode::GetChunk() {
+    if (!chunk_) {
+        chunk_ = std::make_shared<Chunk>();
+        for (size_t i = 0; i < body_.size(); ++i) {
+            if (i > 0) {
+                chunk_->Emit(OpCode::kPop);
+            }
+            body_[i]->Emit(chunk_.get());
+        }
+        if (body_.empty()) {
+            chunk_->Emit(OpCode::kConstant, chunk_->AddConstant(nullptr));
+        }
+        chunk_->Emit(OpCode::kReturn);
+    }
+    return *chunk_;
+}
+
+void CallNode::Emit(Chunk* chunk) {
+    function_->Emit(chunk);
+    for (auto& arg : args_) {
+        arg->Emit(chunk);
+    }
+    chunk->Emit(tail_ ? OpCode::kTailCall : OpCode::kCall, args_.size());
+}
+
+// Analysis
+
+// Variables of the lambdas enclosing the analyzed expression: parameters
+// first, then everything the body defines. Top-level code has no lexical
+// scope and uses the global table.
+struct LexicalScope {
+    std::vector<SymbolPtr> names;
+    const LexicalScope* parent;
+};
+
+static NodePtr AnalyzeExpression(const ObjectPtr& obj, const LexicalScope* scope);
+
+static std::optional<LocalAddress> Resolve(const SymbolPtr& symbol, const LexicalScope* scope) {
+    for (size_t depth = 0; scope; ++depth, scope = scope->parent) {
+        for (size_t slot = 0; slot < scope->names.size(); ++slot) {
+            if (scope->names[slot] == symbol) {
+                return LocalAddress{symbol, depth, slot};
+            }
+        }
+    }
+    return std::nullopt;
+}
+
+static std::optional<LocalAddress> ResolveInCurrentFrame(const SymbolPtr& symbol,
+                                                         const LexicalScope* scope) {
+    if (!scope) {
+        return std::nullopt;
+    }
+    std::optional<LocalAddress> address = Resolve(symbol, scope);
+    if (!address || address->depth != 0) {
+        throw SyntaxError("Unresolved definition of " + symbol->GetName());
+    }
+    return address;
+}
+
+static void AddName(std::vector<SymbolPtr>* names, const SymbolPtr& symbol) {
+    for (auto& name : *names) {
+        if (name == symbol) {
+            return;
+        }
+    }
+    names->push_back(symbol);
+}
+
+// Finds the variables a lambda body defines, so they get slots in its frame.
+// Nested lambdas and quoted data are skipped.
+static void CollectDefinitions(const ObjectPtr& obj, std::vector<SymbolPtr>* names) {
+    if (!Is<Cell>(obj)) {
+        return;
+    }
+    static const SymbolPtr kQuote = Intern("quote");
+    static const SymbolPtr kLambda = Intern("lambda");
+    static const SymbolPtr kDefine = Intern("define");
+    static const SymbolPtr kDefineMemoized = Intern("define-memoized");
+    ObjectPtr head = Cast<Cell>(obj)->GetFirst();
+    if (head == kQuote || head == kLambda) {
+        return;
+    }
+    ObjectPtr tail = Cast<Cell>(obj)->GetSecond();
+    if ((head == kDefine || head == kDefineMemoized) && Is<Cell>(tail)) {
+        ObjectPtr target = Cast<Cell>(tail)->GetFirst();
+        if (IsSymbol(target)) {
+            AddName(names, As<Symbol>(target));
+        } else if (Is<Cell>(target)) {
+            if (IsSymbol(Cast<Cell>(target)->GetFirst())) {
+                AddName(names, As<Symbol>(Cast<Cell>(target)->GetFirst()));
+            }
+            return;
+        }
+    }
+    for (ObjectPtr cell = obj; Is<Cell>(cell); cell = Cast<Cell>(cell)->GetSecond()) {
+        CollectDefinitions(Cast<Cell>(cell)->GetFirst(), names);
+    }
+}
+
+static std::vector<NodePtr> AnalyzeAll(const std::vector<ObjectPtr>& list,
+                                       const LexicalScope* scope, size_t from = 0) {
+    std::vector<NodePtr> nodes;
+    for (size_t i = from; i < list.size(); ++i) {
+        nodes.push_back(AnalyzeExpression(list[i], scope));
+    }
+    return nodes;
+}
+
+static NodePtr AnalyzeLambdaBody(ObjectPtr params, const std::vector<ObjectPtr>& args,
+                                 const LexicalScope* scope) {
+    LexicalScope lambda_scope{GetSymbolsList(params), scope};
+    size_t params_count = lambda_scope.names.size();
+    for (size_t i = 1; i < args.size(); ++i) {
+        CollectDefinitions(args[i], &lambda_scope.names);
+    }
+    return std::make_shared<LambdaNode>(params_count, lambda_scope.names.size(),
+                                        AnalyzeAll(args, &lambda_scope, 1));
+}
+
+// Special forms
+
+static NodePtr AnalyzeQuote(const std::vector<ObjectPtr>& args, const LexicalScope*) {
+    CheckArgumentsCount<RuntimeError>(args, 1, 1);
+    return std::make_shared<ConstantNode>(args[0]);
+}
+
+static NodePtr AnalyzeIf(const std::vector<ObjectPtr>& args, const LexicalScope* scope) {
+    CheckArgumentsCount<SyntaxError>(args, 2, 3);
+    NodePtr condition = AnalyzeExpression(args[0], scope);
+    NodePtr then_branch = AnalyzeExpression(args[1], scope);
+    NodePtr else_branch = (args.size() == 3 ? AnalyzeExpression(args[2], scope) : nullptr);
+    return FoldIf(condition, then_branch, else_branch,
+                  std::make_shared<IfNode>(condition, then_branch, else_branch));
+}
+
+static NodePtr AnalyzeLambda(const std::vector<ObjectPtr>& args, const LexicalScope* scope) {
+    CheckArgumentsCount<SyntaxError>(args, 2);
+    if (!IsCorrectList(args[0])) {
+        throw SyntaxError("Wrong lambda syntax");
+    }
+    return AnalyzeLambdaBody(args[0], args, scope);
+}
+
+static NodePtr AnalyzeDefine(const std::vector<ObjectPtr>& args, const LexicalScope* scope) {
+    CheckArgumentsCount<SyntaxError>(args, 2);
+    if (IsSymbol(args[0])) {
+        if (args.size() > 2) {
+            throw SyntaxError("Define expects 2 arguments, got " + std::to_string(args.size()));
+        }
+        SymbolPtr name = As<Symbol>(args[0]);
+        NodePtr value = AnalyzeExpression(args[1], scope);
+        value->MarkDefinedAs(name.get());
+        return std::make_shared<DefineNode>(name, ResolveInCurrentFrame(name, scope), value);
+    } else if (IsCorrectList(args[0])) {
+        if (auto name_ptr = GetHeadFromList(args[0]); Is<Symbol>(name_ptr)) {
+            SymbolPtr name = As<Symbol>(name_ptr);
+            NodePtr lambda = AnalyzeLambdaBody(GetTailFromList(args[0]), args, scope);
+            lambda->MarkDefinedAs(name.get());
+            return std::make_shared<DefineNode>(name, ResolveInCurrentFrame(name, scope), lambda);
+        } else {
+            throw RuntimeError("Name of Lambda should be Symbol");
+        }
+    } else {
+        throw RuntimeError("First argument of define should be Symbol or Lambda declaration");
+    }
+}
+
+// (define-memoized (name params...) body...) binds name to the memoized
+// lambda, so the recursive calls of its body go through the cache too.
+static NodePtr AnalyzeDefineMemoized(const std::vector<ObjectPtr>& args,
+                                     const LexicalScope* scope) {
+    CheckArgumentsCount<SyntaxError>(args, 2);
+    if (!IsCorrectList(args[0]) || !IsSymbol(GetHeadFromList(args[0]))) {
+        throw SyntaxError("define-memoized expects a lambda declaration");
+    }
+    static const ObjectPtr kMemoize = [] {
+        auto memoize = std::make_shared<MemoizeFunction>();
+        memoize->SetName(Intern("memoize").get());
+        return memoize;
+    }();
+    SymbolPtr name = As<Symbol>(GetHeadFromList(args[0]));
+    NodePtr lambda = AnalyzeLambdaBody(GetTailFromList(args[0]), args, scope);
+    lambda->MarkDefinedAs(name.get());
+    NodePtr memoized = std::make_shared<CallNode>(std::make_shared<ConstantNode>(kMemoize),
+                                                  std::vector<NodePtr>{lambda});
+    return std::make_shared<DefineNode>(name, ResolveInCurrentFrame(name, scope), memoized);
+}
+
+static NodePtr AnalyzeSet(const std::vector<ObjectPtr>& args, const LexicalScope* scope) {
+    CheckArgumentsCount<SyntaxError>(args, 2, 2);
+    if (!IsSymbol(args[0])) {
+        throw RuntimeError("Name of variable should be Symbol");
+    }
+    SymbolPtr name = As<Symbol>(args[0]);
+    return std::make_shared<SetNode>(name, Resolve(name, scope), AnalyzeExpression(args[1], scope));
+}
+
+static NodePtr AnalyzeAnd(const std::vector<ObjectPtr>& args, const LexicalScope* scope) {
+    return std::make_shared<AndNode>(AnalyzeAll(args, scope));
+}
+
+static NodePtr AnalyzeOr(const std::vector<ObjectPtr>& args, const LexicalScope* scope) {
+    return std::make_shared<OrNode>(AnalyzeAll(args, scope));
+}
+
+using SpecialForm = NodePtr (*)(const std::vector<ObjectPtr>& args, const LexicalScope* scope);
+
+static const std::unordered_map<const Symbol*, SpecialForm>& GetSpecialForms() {
+    static const std::unordered_map<const Symbol*, SpecialForm> kSpecialForms = {
+        {Intern("quote").get(), AnalyzeQuote},   {Intern("if").get(), AnalyzeIf},
+        {Intern("lambda").get(), AnalyzeLambda}, {Intern("define").get(), AnalyzeDefine},
+        {Intern("set!").get(), AnalyzeSet},      {Intern("and").get(), AnalyzeAnd},
+        {Intern("or").get(), AnalyzeOr},
+        {Intern("define-memoized").get(), AnalyzeDefineMemoized},
+    };
+    return kSpecialForms;
+}
+
+static NodePtr AnalyzeExpression(const ObjectPtr& obj, const LexicalScope* scope) {
+    if (!obj) {
+        return std::make_shared<InvalidNode>("Lists are not self evaluating");
+    } else if (IsBoolean(obj) || IsNumber(obj) || IsVector(obj) || IsNumericVector(obj)) {
+        return std::make_shared<ConstantNode>(obj);
+    } else if (IsSymbol(obj)) {
+        SymbolPtr name = As<Symbol>(obj);
+        if (auto address = Resolve(name, scope)) {
+            return std::make_shared<LocalVariableNode>(*address);
+        }
+        return std::make_shared<GlobalVariableNode>(name);
+    }
+
+    ObjectPtr head = GetHeadFromList(obj);
+    std::vector<ObjectPtr> args = GetArgList(GetTailFromList(obj));
+    // A local variable shadows the special form or builtin with the same name.
+    bool is_global = IsSymbol(head) && !Resolve(As<Symbol>(head), scope);
+    if (is_global) {
+        const auto& special_forms = GetSpecialForms();
+        if (auto it = special_forms.find(As<Symbol>(head).get()); it != special_forms.end()) {
+            return it->second(args, scope);
+        }
+    }
+    std::vector<NodePtr> operands = AnalyzeAll(args, scope);
+    NodePtr call = std::make_shared<CallNode>(AnalyzeExpression(head, scope), operands);
+    return is_global ? FoldCall(As<Symbol>(head), operands, std::move(call)) : call;
+}
+
+NodePtr Analyze(const ObjectPtr& obj) {
+    return AnalyzeExpression(obj, nullptr);
+}
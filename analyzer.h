@@ -0,0 +1,237 @@
+#pragma once
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+#include "object.h"
+#include "scope.h"
+#include "context.h"
+
+class Node;
+class Chunk;
+
+using NodePtr = std::shared_ptr<Node>;
+
+// Executable form of an expression. The analysis pass resolves the syntax of
+// a parsed datum once, so executing a node never has to re-inspect Cells.
+// Emit lowers the same node to bytecode for the virtual machine.
+
+class Node {
+public:
+    virtual ~Node() = default;
+    virtual ObjectPtr Execute(Context* context) = 0;
+    virtual void Emit(Chunk* chunk) = 0;
+
+    // Called for the expression whose value a lambda body returns.
+    virtual void MarkTailPosition() {
+    }
+
+    // Called for the value expression of a define.
+    virtual void MarkDefinedAs(const Symbol*) {
+    }
+
+    // Value the node evaluates to if it is known before it runs.
+    virtual const ObjectPtr* GetConstantValue() const {
+        return nullptr;
+    }
+};
+
+class ConstantNode : public Node {
+public:
+    explicit ConstantNode(ObjectPtr value) : value_(value) {
+    }
+
+    ObjectPtr Execute(Context* context) override;
+    void Emit(Chunk* chunk) override;
+    const ObjectPtr* GetConstantValue() const override;
+
+private:
+    ObjectPtr value_;
+};
+
+// Code simplified by constant folding (see folding.h). Runs optimized until
+// one of the builtins folding relies on is redefined, and fallback, the code
+// as written, from then on.
+class FoldedNode : public Node {
+public:
+    FoldedNode(NodePtr optimized, NodePtr fallback)
+        : optimized_(std::move(optimized)), fallback_(std::move(fallback)) {
+    }
+
+    ObjectPtr Execute(Context* context) override;
+    void Emit(Chunk* chunk) override;
+    void MarkTailPosition() override;
+    const ObjectPtr* GetConstantValue() const override;
+
+private:
+    NodePtr optimized_;
+    NodePtr fallback_;
+};
+
+class InvalidNode : public Node {
+public:
+    explicit InvalidNode(const std::string& message) : message_(message) {
+    }
+
+    ObjectPtr Execute(Context* context) override;
+    void Emit(Chunk* chunk) override;
+
+private:
+    std::string message_;
+};
+
+class LocalVariableNode : public Node {
+public:
+    explicit LocalVariableNode(const LocalAddress& address) : address_(address) {
+    }
+
+    ObjectPtr Execute(Context* context) override;
+    void Emit(Chunk* chunk) override;
+
+private:
+    LocalAddress address_;
+};
+
+class GlobalVariableNode : public Node {
+public:
+    explicit GlobalVariableNode(const SymbolPtr& name) : name_(name) {
+    }
+
+    ObjectPtr Execute(Context* context) override;
+    void Emit(Chunk* chunk) override;
+
+private:
+    SymbolPtr name_;
+    GlobalCache cache_;
+};
+
+// Define and set! target either a slot of the current lambda frame (local) or
+// the global table (name).
+
+class DefineNode : public Node {
+public:
+    DefineNode(const SymbolPtr& name, std::optional<LocalAddress> local, NodePtr value)
+        : name_(name), local_(local), value_(value) {
+    }
+
+    ObjectPtr Execute(Context* context) override;
+    void Emit(Chunk* chunk) override;
+
+private:
+    SymbolPtr name_;
+    std::optional<LocalAddress> local_;
+    NodePtr value_;
+};
+
+class SetNode : public Node {
+public:
+    SetNode(const SymbolPtr& name, std::optional<LocalAddress> local, NodePtr value)
+        : name_(name), local_(local), value_(value) {
+    }
+
+    ObjectPtr Execute(Context* context) override;
+    void Emit(Chunk* chunk) override;
+
+private:
+    SymbolPtr name_;
+    std::optional<LocalAddress> local_;
+    NodePtr value_;
+};
+
+class IfNode : public Node {
+public:
+    IfNode(NodePtr condition, NodePtr then_branch, NodePtr else_branch)
+        : condition_(condition), then_branch_(then_branch), else_branch_(else_branch) {
+    }
+
+    ObjectPtr Execute(Context* context) override;
+    void Emit(Chunk* chunk) override;
+    void MarkTailPosition() override;
+
+private:
+    NodePtr condition_, then_branch_, else_branch_;
+};
+
+class AndNode : public Node {
+public:
+    explicit AndNode(std::vector<NodePtr> operands) : operands_(std::move(operands)) {
+    }
+
+    ObjectPtr Execute(Context* context) override;
+    void Emit(Chunk* chunk) override;
+    void MarkTailPosition() override;
+
+private:
+    std::vector<NodePtr> operands_;
+};
+
+class OrNode : public Node {
+public:
+    explicit OrNode(std::vector<NodePtr> operands) : operands_(std::move(operands)) {
+    }
+
+    ObjectPtr Execute(Context* context) override;
+    void Emit(Chunk* chunk) override;
+    void MarkTailPosition() override;
+
+private:
+    std::vector<NodePtr> operands_;
+};
+
+class LambdaNode : public Node, public std::enable_shared_from_this<LambdaNode> {
+public:
+    LambdaNode(size_t params_count, size_t frame_size, std::vector<NodePtr> body);
+
+    ObjectPtr Execute(Context* context) override;
+    void Emit(Chunk* chunk) override;
+    void MarkDefinedAs(const Symbol* name) override;
+
+    size_t GetParamsCount() const;
+    size_t GetFrameSize() const;
+    // Name of the variable the lambda was defined as, if any.
+    const Symbol* GetName() const;
+    ObjectPtr ExecuteBody(Context* context) const;
+    const Chunk& GetChunk();
+
+private:
+    size_t params_count_;
+    size_t frame_size_;
+    std::vector<NodePtr> body_;
+    std::shared_ptr<Chunk> chunk_;
+    const Symbol* name_ = nullptr;
+};
+
+class CallNode : public Node {
+public:
+    CallNode(NodePtr function, std::vector<NodePtr> args)
+        : function_(function), args_(std::move(args)) {
+    }
+
+    ObjectPtr Execute(Context* context) override;
+    void Emit(Chunk* chunk) override;
+    void MarkTailPosition() override;
+
+private:
+    NodePtr function_;
+    std::vector<NodePtr> args_;
+    bool tail_ = false;
+};
+
+// Creates the frame for a call of lambda, checking the number of arguments.
+std::shared_ptr<Frame> MakeFrame(const Lambda& lambda, std::vector<ObjectPtr> args);
+
+// Calls lambda with evaluated arguments. Calls made from tail positions of its
+// body are run by this loop instead of nesting, so tail recursion uses
+// constant stack.
+ObjectPtr CallLambda(Context* context, std::shared_ptr<Lambda> lambda,
+                     std::vector<ObjectPtr> args);
+
+// Applies function to evaluated arguments. Builtin calls are reported to the
+// profiler here; lambdas report themselves in CallLambda. Throws RuntimeError
+// if function is not a function.
+ObjectPtr ApplyFunction(Context* context, const ObjectPtr& function,
+                        const std::vector<ObjectPtr>& args);
+
+// Analysis pass: turns a parsed datum into a tree of executable nodes.
+NodePtr Analyze(const ObjectPtr& obj);
@@ -0,0 +1,74 @@
+#include "benchmark.h"
+#include "allocator.h"
+#include <sys/resource.h>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+std::atomic<size_t> heap_allocations = 0;
+
+size_t GetPeakRssKib() {
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+}  // namespace
+
+void* operator new(size_t size) {
+    heap_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* ptr = std::malloc(size ? size : 1)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    std::free(ptr);
+}
+
+size_t GetHeapAllocations() {
+    return heap_allocations.load(std::memory_order_relaxed);
+}
+
+BenchmarkRunner::BenchmarkRunner(std::ostream* out, std::string filter, double min_seconds)
+    : out_(out), filter_(std::move(filter)), min_seconds_(min_seconds) {
+}
+
+void BenchmarkRunner::Run(const std::string& name, size_t items_per_op,
+                          const std::function<void()>& body) {
+    if (name.find(filter_) == std::string::npos) {
+        return;
+    }
+    // Warm up caches and pools before anything is counted.
+    body();
+
+    size_t heap_before = GetHeapAllocations();
+    size_t objects_before = GetObjectPoolStats().allocations;
+    auto start = std::chrono::steady_clock::now();
+    size_t iterations = 0;
+    std::chrono::duration<double> elapsed{};
+    do {
+        body();
+        ++iterations;
+        elapsed = std::chrono::steady_clock::now() - start;
+    } while (elapsed.count() < min_seconds_);
+    size_t heap = GetHeapAllocations() - heap_before;
+    size_t objects = GetObjectPoolStats().allocations - objects_before;
+
+    double seconds = elapsed.count();
+    *out_ << "{\"name\": \"" << name << "\", \"iterations\": " << iterations
+          << ", \"seconds\": " << seconds << ", \"ops_per_sec\": " << iterations / seconds
+          << ", \"ns_per_op\": " << seconds * 1e9 / iterations
+          << ", \"items_per_sec\": " << iterations * items_per_op / seconds
+          << ", \"heap_allocations_per_op\": " << heap / iterations
+          << ", \"object_allocations_per_op\": " << objects / iterations
+          << ", \"peak_rss_kib\": " << GetPeakRssKib() << "}" << std::endl;
+}
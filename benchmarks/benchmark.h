@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <ostream>
+#include <string>
+
+// Minimal microbenchmark harness. Every benchmark is run repeatedly until it
+// has taken at least the minimal time, and reported as one JSON object per
+// line:
+//
+//     {"name": "eval/fib/tree", "iterations": 12, "seconds": 0.51,
+//      "ops_per_sec": 23.5, "ns_per_op": 42553191, "items_per_sec": 515993,
+//      "heap_allocations_per_op": 0, "object_allocations_per_op": 57313,
+//      "peak_rss_kib": 10244}
+//
+// Heap allocations count calls of the global operator new, object
+// allocations count blocks taken from the interpreter's object pools. Peak
+// RSS is the high-water mark of the whole process so far, so benchmarks
+// should be ordered from small to large footprints to keep it informative.
+class BenchmarkRunner {
+public:
+    // Benchmarks whose name does not contain filter are skipped.
+    BenchmarkRunner(std::ostream* out, std::string filter, double min_seconds);
+
+    // Runs body, which performs one operation processing items_per_op items
+    // (tokens, list elements, ...).
+    void Run(const std::string& name, size_t items_per_op, const std::function<void()>& body);
+
+private:
+    std::ostream* out_;
+    std::string filter_;
+    double min_seconds_;
+};
+
+// Number of calls of the global operator new so far.
+size_t GetHeapAllocations();
+
+// Keeps the compiler from dropping computations whose result is unused.
+template <class T>
+void DoNotOptimize(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
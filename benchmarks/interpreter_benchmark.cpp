@@ -0,0 +1,156 @@
+// Benchmark suite of the interpreter: tokenizer, parser, evaluation of
+// classic workloads in both execution modes, and the printer. Results are
+// written to stdout as JSON lines, see benchmark.h.
+//
+// Build and run from the repository root:
+//     cmake -S . -B build && cmake --build build --target interpreter_benchmark
+//     build/interpreter_benchmark
+//
+// Usage: interpreter_benchmark [filter [min_seconds]]
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include "benchmark.h"
+#include "parser.h"
+#include "printer.h"
+#include "scheme.h"
+#include "tokenizer.h"
+
+namespace {
+
+// Definitions shared by the evaluation benchmarks. The language has no let
+// and no begin, so loops are written as tail-recursive helpers.
+const char* kPrelude[] = {
+    "(define (fib n) (if (< n 2) n (+ (fib (- n 1)) (fib (- n 2)))))",
+    "(define (tak x y z) (if (not (< y x)) z"
+    "  (tak (tak (- x 1) y z) (tak (- y 1) z x) (tak (- z 1) x y))))",
+    "(define (ack m n) (if (= m 0) (+ n 1)"
+    "  (if (= n 0) (ack (- m 1) 1) (ack (- m 1) (ack m (- n 1))))))",
+    "(define (build n acc) (if (= n 0) acc (build (- n 1) (cons n acc))))",
+    "(define (reverse-onto list acc)"
+    "  (if (null? list) acc (reverse-onto (cdr list) (cons (car list) acc))))",
+    "(define (make-counter) (define count 0) (lambda () (set! count (+ count 1)) count))",
+    "(define (compose f g) (lambda (x) (f (g x))))",
+    "(define (make-adder n) (lambda (x) (+ x n)))",
+    "(define (closures n acc)"
+    "  (if (= n 0) acc (closures (- n 1) ((compose (make-adder n) (make-adder 1)) acc))))",
+    "(define (call-counter counter n) (counter) (if (= n 0) (counter)"
+    "  (call-counter counter (- n 1))))",
+    "(define (mutate list n) (if (= n 0) list (mutate (mutate-each list list n) (- n 1))))",
+    "(define (mutate-each head list n) (if (null? list) head (mutate-next head list n)))",
+    "(define (mutate-next head list n) (set-car! list n) (set-cdr! list (cdr list))"
+    "  (mutate-each head (cdr list) n))",
+};
+
+// Source of a list with length elements mixing numbers and symbols.
+std::string MakeListSource(size_t length) {
+    std::string source = "(";
+    for (size_t i = 0; i < length; ++i) {
+        source += (i % 2 ? "symbol " : "12345 ");
+        if (i % 16 == 15) {
+            source += "(nested 'quoted . pair) ";
+        }
+    }
+    source += ")";
+    return source;
+}
+
+size_t CountTokens(const std::string& source) {
+    Tokenizer tokenizer{std::string_view(source)};
+    size_t count = 0;
+    for (; !tokenizer.IsEnd(); tokenizer.Next()) {
+        ++count;
+    }
+    return count;
+}
+
+void RunFrontendBenchmarks(BenchmarkRunner* runner) {
+    const std::string source = MakeListSource(100000);
+    const size_t tokens = CountTokens(source);
+
+    runner->Run("tokenizer/list-100k", tokens, [&source] {
+        Tokenizer tokenizer{std::string_view(source)};
+        size_t count = 0;
+        for (; !tokenizer.IsEnd(); tokenizer.Next()) {
+            ++count;
+        }
+        DoNotOptimize(count);
+    });
+    runner->Run("tokenizer/stream-list-100k", tokens, [&source] {
+        std::istringstream stream(source);
+        Tokenizer tokenizer(&stream);
+        size_t count = 0;
+        for (; !tokenizer.IsEnd(); tokenizer.Next()) {
+            ++count;
+        }
+        DoNotOptimize(count);
+    });
+    runner->Run("parser/list-100k", tokens, [&source] {
+        Tokenizer tokenizer{std::string_view(source)};
+        ObjectPtr result = Read(&tokenizer);
+        DoNotOptimize(result);
+    });
+}
+
+void RunPrinterBenchmarks(BenchmarkRunner* runner) {
+    const std::string source = MakeListSource(100000);
+    Tokenizer tokenizer{std::string_view(source)};
+    ObjectPtr list = Read(&tokenizer);
+    runner->Run("printer/list-100k", 100000, [&list] {
+        std::ostringstream out;
+        Print(list, &out);
+        DoNotOptimize(out.tellp());
+    });
+
+    Interpreter interpreter;
+    interpreter.Run("(define cycle (list 1 2 3 4 5 6 7 8))");
+    interpreter.Run("(set-cdr! (cdr (cdr (cdr (cdr (cdr (cdr (cdr cycle))))))) cycle)");
+    runner->Run("printer/cycle", 8, [&interpreter] {
+        DoNotOptimize(interpreter.Run("cycle"));
+    });
+}
+
+struct Workload {
+    const char* name;
+    const char* expression;
+    size_t items;
+};
+
+// Items are calls for the recursive workloads and list elements otherwise.
+const Workload kWorkloads[] = {
+    {"fib-20", "(fib 20)", 21891},
+    {"tak-18-12-6", "(tak 18 12 6)", 63609},
+    {"ack-3-5", "(ack 3 5)", 42438},
+    {"build-list-10k", "(car (build 10000 '()))", 10000},
+    {"reverse-list-10k", "(car (reverse-onto (build 10000 '()) '()))", 20000},
+    {"closures-10k", "(closures 10000 0)", 10000},
+    {"counter-10k", "(call-counter (make-counter) 10000)", 10000},
+    {"set-car-cdr-100x100", "(mutate (build 100 '()) 100)", 10000},
+};
+
+void RunEvaluationBenchmarks(BenchmarkRunner* runner, ExecutionMode mode, const char* suffix) {
+    Interpreter interpreter(mode);
+    for (const char* definition : kPrelude) {
+        interpreter.Run(definition);
+    }
+    for (const Workload& workload : kWorkloads) {
+        std::string name = std::string("eval/") + workload.name + "/" + suffix;
+        runner->Run(name, workload.items, [&interpreter, &workload] {
+            DoNotOptimize(interpreter.Run(workload.expression));
+        });
+    }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    std::string filter = argc > 1 ? argv[1] : "";
+    double min_seconds = argc > 2 ? std::stod(argv[2]) : 0.5;
+    BenchmarkRunner runner(&std::cout, filter, min_seconds);
+
+    RunFrontendBenchmarks(&runner);
+    RunPrinterBenchmarks(&runner);
+    RunEvaluationBenchmarks(&runner, ExecutionMode::kTreeWalking, "tree");
+    RunEvaluationBenchmarks(&runner, ExecutionMode::kBytecode, "bytecode");
+}
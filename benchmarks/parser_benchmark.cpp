@@ -0,0 +1,57 @@
+// Parser throughput on machine-generated input: a flat list of 10^6 elements
+// and a list nested 10^5 levels deep.
+//
+// Build and run from the repository root:
+//     cmake -S . -B build && cmake --build build --target parser_benchmark
+//     build/parser_benchmark
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include "parser.h"
+#include "tokenizer.h"
+
+namespace {
+
+std::string MakeLongList(size_t length) {
+    std::string source = "(";
+    for (size_t i = 0; i < length; ++i) {
+        source += (i % 2 ? "symbol " : "12345 ");
+    }
+    source += ")";
+    return source;
+}
+
+std::string MakeDeepList(size_t depth) {
+    std::string source;
+    for (size_t i = 0; i < depth; ++i) {
+        source += "(x ";
+    }
+    source += "'y";
+    source.append(depth, ')');
+    return source;
+}
+
+void Measure(const std::string& name, const std::string& source) {
+    auto start = std::chrono::steady_clock::now();
+    ObjectPtr result;
+    {
+        Tokenizer tokenizer{std::string_view(source)};
+        result = Read(&tokenizer);
+    }
+    auto parsed = std::chrono::steady_clock::now();
+    result.reset();
+    auto freed = std::chrono::steady_clock::now();
+
+    std::chrono::duration<double, std::milli> parse_time = parsed - start;
+    std::chrono::duration<double, std::milli> free_time = freed - parsed;
+    std::cout << name << ": " << source.size() / 1024 << " KiB, parse " << parse_time.count()
+              << " ms, free " << free_time.count() << " ms\n";
+}
+
+}  // namespace
+
+int main() {
+    Measure("long list (10^6 elements)", MakeLongList(1000000));
+    Measure("deep nesting (10^5 levels)", MakeDeepList(100000));
+}
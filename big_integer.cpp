@@ -0,0 +1,404 @@
+#include "big_integer.h"
+#include "error.h"
+#include <algorithm>
+#include <bit>
+#include <span>
+
+namespace {
+
+using Limbs = std::vector<uint32_t>;
+using LimbSpan = std::span<const uint32_t>;
+
+// Below this number of limbs in the shorter operand, the schoolbook method
+// beats the bookkeeping of Karatsuba.
+constexpr size_t kKaratsubaThreshold = 32;
+
+// Largest power of ten that fits into a limb, used to convert from and to
+// decimal nine digits at a time.
+constexpr uint32_t kDecimalBase = 1000000000;
+constexpr size_t kDecimalDigits = 9;
+
+void Trim(Limbs* limbs) {
+    while (!limbs->empty() && limbs->back() == 0) {
+        limbs->pop_back();
+    }
+}
+
+LimbSpan Trimmed(LimbSpan limbs) {
+    while (!limbs.empty() && limbs.back() == 0) {
+        limbs = limbs.first(limbs.size() - 1);
+    }
+    return limbs;
+}
+
+int CompareMagnitudes(LimbSpan lhs, LimbSpan rhs) {
+    if (lhs.size() != rhs.size()) {
+        return lhs.size() < rhs.size() ? -1 : 1;
+    }
+    for (size_t i = lhs.size(); i-- > 0;) {
+        if (lhs[i] != rhs[i]) {
+            return lhs[i] < rhs[i] ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+Limbs AddMagnitudes(LimbSpan lhs, LimbSpan rhs) {
+    if (lhs.size() < rhs.size()) {
+        std::swap(lhs, rhs);
+    }
+    Limbs sum(lhs.size() + 1);
+    uint64_t carry = 0;
+    for (size_t i = 0; i < lhs.size(); ++i) {
+        carry += static_cast<uint64_t>(lhs[i]) + (i < rhs.size() ? rhs[i] : 0);
+        sum[i] = static_cast<uint32_t>(carry);
+        carry >>= 32;
+    }
+    sum[lhs.size()] = static_cast<uint32_t>(carry);
+    Trim(&sum);
+    return sum;
+}
+
+// Subtracts rhs from lhs in place; lhs must not be smaller than rhs.
+void SubtractInPlace(Limbs* lhs, LimbSpan rhs) {
+    int64_t borrow = 0;
+    for (size_t i = 0; i < lhs->size() && (i < rhs.size() || borrow); ++i) {
+        int64_t difference = static_cast<int64_t>((*lhs)[i]) - borrow;
+        difference -= (i < rhs.size() ? rhs[i] : 0);
+        borrow = difference < 0;
+        (*lhs)[i] = static_cast<uint32_t>(difference);
+    }
+    Trim(lhs);
+}
+
+// Adds addend shifted left by shift limbs to sum in place.
+void AddShifted(Limbs* sum, LimbSpan addend, size_t shift) {
+    if (sum->size() < addend.size() + shift) {
+        sum->resize(addend.size() + shift);
+    }
+    uint64_t carry = 0;
+    for (size_t i = 0; i < addend.size() || carry; ++i) {
+        if (shift + i == sum->size()) {
+            sum->push_back(0);
+        }
+        carry += static_cast<uint64_t>((*sum)[shift + i]) + (i < addend.size() ? addend[i] : 0);
+        (*sum)[shift + i] = static_cast<uint32_t>(carry);
+        carry >>= 32;
+    }
+    Trim(sum);
+}
+
+Limbs MultiplySchoolbook(LimbSpan lhs, LimbSpan rhs) {
+    Limbs product(lhs.size() + rhs.size());
+    for (size_t i = 0; i < lhs.size(); ++i) {
+        uint64_t carry = 0;
+        for (size_t j = 0; j < rhs.size(); ++j) {
+            carry += static_cast<uint64_t>(lhs[i]) * rhs[j] + product[i + j];
+            product[i + j] = static_cast<uint32_t>(carry);
+            carry >>= 32;
+        }
+        product[i + rhs.size()] = static_cast<uint32_t>(carry);
+    }
+    Trim(&product);
+    return product;
+}
+
+// Karatsuba: with x = x1 * B^k + x0, the product needs three half-size
+// products, x0 * y0, x1 * y1 and (x0 + x1) * (y0 + y1), instead of four.
+Limbs MultiplyMagnitudes(LimbSpan lhs, LimbSpan rhs) {
+    lhs = Trimmed(lhs);
+    rhs = Trimmed(rhs);
+    if (lhs.size() < rhs.size()) {
+        std::swap(lhs, rhs);
+    }
+    if (rhs.size() < kKaratsubaThreshold) {
+        return rhs.empty() ? Limbs() : MultiplySchoolbook(lhs, rhs);
+    }
+    size_t k = lhs.size() / 2;
+    if (rhs.size() <= k) {
+        // Too unbalanced to split both; split only the longer operand.
+        Limbs product = MultiplyMagnitudes(lhs.first(k), rhs);
+        AddShifted(&product, MultiplyMagnitudes(lhs.subspan(k), rhs), k);
+        return product;
+    }
+    LimbSpan lhs_low = lhs.first(k), lhs_high = lhs.subspan(k);
+    LimbSpan rhs_low = rhs.first(k), rhs_high = rhs.subspan(k);
+    Limbs low = MultiplyMagnitudes(lhs_low, rhs_low);
+    Limbs high = MultiplyMagnitudes(lhs_high, rhs_high);
+    Limbs middle = MultiplyMagnitudes(AddMagnitudes(lhs_low, lhs_high),
+                                      AddMagnitudes(rhs_low, rhs_high));
+    SubtractInPlace(&middle, low);
+    SubtractInPlace(&middle, high);
+
+    Limbs product = std::move(low);
+    AddShifted(&product, middle, k);
+    AddShifted(&product, high, 2 * k);
+    return product;
+}
+
+// Divides in place by a single limb; returns the remainder.
+uint32_t DivideBySmall(Limbs* dividend, uint32_t divisor) {
+    uint64_t remainder = 0;
+    for (size_t i = dividend->size(); i-- > 0;) {
+        uint64_t current = (remainder << 32) | (*dividend)[i];
+        (*dividend)[i] = static_cast<uint32_t>(current / divisor);
+        remainder = current % divisor;
+    }
+    Trim(dividend);
+    return static_cast<uint32_t>(remainder);
+}
+
+void MultiplyAddSmall(Limbs* value, uint32_t factor, uint32_t addend) {
+    uint64_t carry = addend;
+    for (uint32_t& limb : *value) {
+        carry += static_cast<uint64_t>(limb) * factor;
+        limb = static_cast<uint32_t>(carry);
+        carry >>= 32;
+    }
+    if (carry) {
+        value->push_back(static_cast<uint32_t>(carry));
+    }
+}
+
+// Knuth, TAOCP vol. 2, 4.3.1, algorithm D. The divisor is normalized so its
+// top limb has the high bit set; then the quotient limb estimated from the
+// top two limbs of the remainder is at most two too large.
+void DivideMagnitudes(const Limbs& dividend, const Limbs& divisor, Limbs* quotient,
+                      Limbs* remainder) {
+    if (CompareMagnitudes(dividend, divisor) < 0) {
+        *quotient = Limbs();
+        *remainder = dividend;
+        return;
+    }
+    if (divisor.size() == 1) {
+        *quotient = dividend;
+        uint32_t rest = DivideBySmall(quotient, divisor[0]);
+        *remainder = rest ? Limbs{rest} : Limbs();
+        return;
+    }
+
+    size_t n = divisor.size();
+    size_t m = dividend.size() - n;
+    int shift = std::countl_zero(divisor.back());
+    auto shifted = [shift](const Limbs& limbs, size_t i) {
+        uint64_t high = static_cast<uint64_t>(limbs[i]) << shift;
+        uint64_t low = (shift && i > 0) ? limbs[i - 1] >> (32 - shift) : 0;
+        return static_cast<uint32_t>(high | low);
+    };
+    Limbs v(n), u(dividend.size() + 1);
+    for (size_t i = 0; i < n; ++i) {
+        v[i] = shifted(divisor, i);
+    }
+    for (size_t i = 0; i < dividend.size(); ++i) {
+        u[i] = shifted(dividend, i);
+    }
+    u[dividend.size()] = shift ? dividend.back() >> (32 - shift) : 0;
+
+    constexpr uint64_t kLimbBase = uint64_t{1} << 32;
+    quotient->assign(m + 1, 0);
+    for (size_t j = m + 1; j-- > 0;) {
+        uint64_t top = (static_cast<uint64_t>(u[j + n]) << 32) | u[j + n - 1];
+        uint64_t estimate = top / v[n - 1];
+        uint64_t rest = top % v[n - 1];
+        while (estimate >= kLimbBase || estimate * v[n - 2] > ((rest << 32) | u[j + n - 2])) {
+            --estimate;
+            rest += v[n - 1];
+            if (rest >= kLimbBase) {
+                break;
+            }
+        }
+
+        int64_t borrow = 0;
+        for (size_t i = 0; i < n; ++i) {
+            uint64_t product = estimate * v[i];
+            int64_t difference = u[i + j] - borrow - static_cast<int64_t>(product & 0xFFFFFFFF);
+            u[i + j] = static_cast<uint32_t>(difference);
+            borrow = static_cast<int64_t>(product >> 32) - (difference >> 32);
+        }
+        int64_t difference = u[j + n] - borrow;
+        u[j + n] = static_cast<uint32_t>(difference);
+
+        if (difference < 0) {
+            // The estimate was one too large: add the divisor back.
+            --estimate;
+            uint64_t carry = 0;
+            for (size_t i = 0; i < n; ++i) {
+                carry += static_cast<uint64_t>(u[i + j]) + v[i];
+                u[i + j] = static_cast<uint32_t>(carry);
+                carry >>= 32;
+            }
+            u[j + n] += static_cast<uint32_t>(carry);
+        }
+        (*quotient)[j] = static_cast<uint32_t>(estimate);
+    }
+    Trim(quotient);
+
+    remainder->assign(n, 0);
+    for (size_t i = 0; i < n; ++i) {
+        uint64_t low = u[i] >> shift;
+        uint64_t high = shift ? static_cast<uint64_t>(u[i + 1]) << (32 - shift) : 0;
+        (*remainder)[i] = static_cast<uint32_t>(low | high);
+    }
+    Trim(remainder);
+}
+
+}  // namespace
+
+BigInteger::BigInteger(int64_t value) : negative_(value < 0) {
+    uint64_t magnitude = value < 0 ? 0 - static_cast<uint64_t>(value) : value;
+    for (; magnitude; magnitude >>= 32) {
+        magnitude_.push_back(static_cast<uint32_t>(magnitude));
+    }
+}
+
+BigInteger::BigInteger(bool negative, Limbs magnitude) : magnitude_(std::move(magnitude)) {
+    Trim(&magnitude_);
+    negative_ = negative && !magnitude_.empty();
+}
+
+BigInteger BigInteger::Parse(std::string_view digits) {
+    bool negative = false;
+    if (!digits.empty() && (digits[0] == '+' || digits[0] == '-')) {
+        negative = digits[0] == '-';
+        digits.remove_prefix(1);
+    }
+    if (digits.empty()) {
+        throw SyntaxError("Expected digits");
+    }
+    Limbs magnitude;
+    size_t chunk = digits.size() % kDecimalDigits;
+    if (chunk == 0) {
+        chunk = kDecimalDigits;
+    }
+    for (size_t begin = 0; begin < digits.size(); begin += chunk, chunk = kDecimalDigits) {
+        uint32_t value = 0;
+        uint32_t factor = 1;
+        for (char c : digits.substr(begin, chunk)) {
+            if (c < '0' || c > '9') {
+                throw SyntaxError("Expected digits");
+            }
+            value = value * 10 + (c - '0');
+            factor *= 10;
+        }
+        MultiplyAddSmall(&magnitude, factor, value);
+    }
+    return BigInteger(negative, std::move(magnitude));
+}
+
+std::optional<int64_t> BigInteger::ToInt64() const {
+    if (magnitude_.size() > 2) {
+        return std::nullopt;
+    }
+    uint64_t magnitude = 0;
+    for (size_t i = magnitude_.size(); i-- > 0;) {
+        magnitude = (magnitude << 32) | magnitude_[i];
+    }
+    uint64_t limit = static_cast<uint64_t>(INT64_MAX) + (negative_ ? 1 : 0);
+    if (magnitude > limit) {
+        return std::nullopt;
+    }
+    return negative_ ? static_cast<int64_t>(0 - magnitude) : static_cast<int64_t>(magnitude);
+}
+
+double BigInteger::ToDouble() const {
+    double result = 0;
+    for (size_t i = magnitude_.size(); i-- > 0;) {
+        result = result * 4294967296.0 + magnitude_[i];
+    }
+    return negative_ ? -result : result;
+}
+
+size_t BigInteger::Hash() const {
+    size_t hash = negative_;
+    for (uint32_t limb : magnitude_) {
+        hash = hash * 0x100000001b3 ^ limb;
+    }
+    return hash;
+}
+
+size_t BigInteger::GetMemorySize() const {
+    return magnitude_.capacity() * sizeof(uint32_t);
+}
+
+size_t BigInteger::GetLimbCount() const {
+    return magnitude_.size();
+}
+
+std::string BigInteger::ToString() const {
+    if (magnitude_.empty()) {
+        return "0";
+    }
+    std::vector<uint32_t> chunks;
+    Limbs rest = magnitude_;
+    while (!rest.empty()) {
+        chunks.push_back(DivideBySmall(&rest, kDecimalBase));
+    }
+    std::string result = negative_ ? "-" : "";
+    result += std::to_string(chunks.back());
+    for (size_t i = chunks.size() - 1; i-- > 0;) {
+        std::string chunk = std::to_string(chunks[i]);
+        result.append(kDecimalDigits - chunk.size(), '0');
+        result += chunk;
+    }
+    return result;
+}
+
+bool BigInteger::IsZero() const {
+    return magnitude_.empty();
+}
+
+bool BigInteger::IsNegative() const {
+    return negative_;
+}
+
+BigInteger BigInteger::operator-() const {
+    return BigInteger(!negative_, magnitude_);
+}
+
+BigInteger BigInteger::Abs() const {
+    return BigInteger(false, magnitude_);
+}
+
+BigInteger operator+(const BigInteger& lhs, const BigInteger& rhs) {
+    if (lhs.negative_ == rhs.negative_) {
+        return BigInteger(lhs.negative_, AddMagnitudes(lhs.magnitude_, rhs.magnitude_));
+    }
+    bool lhs_larger = CompareMagnitudes(lhs.magnitude_, rhs.magnitude_) >= 0;
+    const BigInteger& larger = lhs_larger ? lhs : rhs;
+    const BigInteger& smaller = lhs_larger ? rhs : lhs;
+    BigInteger::Limbs difference = larger.magnitude_;
+    SubtractInPlace(&difference, smaller.magnitude_);
+    return BigInteger(larger.negative_, std::move(difference));
+}
+
+BigInteger operator-(const BigInteger& lhs, const BigInteger& rhs) {
+    return lhs + (-rhs);
+}
+
+BigInteger operator*(const BigInteger& lhs, const BigInteger& rhs) {
+    return BigInteger(lhs.negative_ != rhs.negative_,
+                      MultiplyMagnitudes(lhs.magnitude_, rhs.magnitude_));
+}
+
+BigInteger operator/(const BigInteger& lhs, const BigInteger& rhs) {
+    BigInteger::Limbs quotient, remainder;
+    DivideMagnitudes(lhs.magnitude_, rhs.magnitude_, &quotient, &remainder);
+    return BigInteger(lhs.negative_ != rhs.negative_, std::move(quotient));
+}
+
+BigInteger operator%(const BigInteger& lhs, const BigInteger& rhs) {
+    BigInteger::Limbs quotient, remainder;
+    DivideMagnitudes(lhs.magnitude_, rhs.magnitude_, &quotient, &remainder);
+    return BigInteger(lhs.negative_, std::move(remainder));
+}
+
+std::strong_ordering operator<=>(const BigInteger& lhs, const BigInteger& rhs) {
+    if (lhs.negative_ != rhs.negative_) {
+        return lhs.negative_ ? std::strong_ordering::less : std::strong_ordering::greater;
+    }
+    int order = CompareMagnitudes(lhs.magnitude_, rhs.magnitude_);
+    if (lhs.negative_) {
+        order = -order;
+    }
+    return order <=> 0;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <compare>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Arbitrary-precision integer in sign-magnitude form. The magnitude is stored
+// as 32-bit limbs, least significant first, without leading zero limbs, so
+// zero has no limbs at all.
+//
+// Multiplication switches from the schoolbook method to Karatsuba once both
+// operands are long; division is Knuth's algorithm D. Division truncates
+// toward zero, like the fixnum division of the interpreter.
+class BigInteger {
+public:
+    BigInteger() = default;
+    BigInteger(int64_t value);
+
+    // Parses an optionally signed string of decimal digits.
+    static BigInteger Parse(std::string_view digits);
+
+    std::optional<int64_t> ToInt64() const;
+    // Closest double up to rounding of the low limbs; overflows to infinity.
+    double ToDouble() const;
+    std::string ToString() const;
+    // Hash of the value, for hash tables.
+    size_t Hash() const;
+    // Bytes of heap memory held by the limbs.
+    size_t GetMemorySize() const;
+    // Number of 32-bit limbs of the magnitude.
+    size_t GetLimbCount() const;
+
+    bool IsZero() const;
+    bool IsNegative() const;
+
+    BigInteger operator-() const;
+    BigInteger Abs() const;
+
+    friend BigInteger operator+(const BigInteger& lhs, const BigInteger& rhs);
+    friend BigInteger operator-(const BigInteger& lhs, const BigInteger& rhs);
+    friend BigInteger operator*(const BigInteger& lhs, const BigInteger& rhs);
+    // The divisor must not be zero.
+    friend BigInteger operator/(const BigInteger& lhs, const BigInteger& rhs);
+    friend BigInteger operator%(const BigInteger& lhs, const BigInteger& rhs);
+
+    friend bool operator==(const BigInteger& lhs, const BigInteger& rhs) = default;
+    friend std::strong_ordering operator<=>(const BigInteger& lhs, const BigInteger& rhs);
+
+private:
+    using Limbs = std::vector<uint32_t>;
+
+    BigInteger(bool negative, Limbs magnitude);
+
+    bool negative_ = false;
+    Limbs magnitude_;
+};
@@ -0,0 +1,81 @@
+#include "bytecode.h"
+#include "analyzer.h"
+
+size_t Chunk::Emit(OpCode op, uint32_t arg) {
+    code_.push_back(Instruction{op, arg});
+    return code_.size() - 1;
+}
+
+void Chunk::Patch(size_t position, uint32_t arg) {
+    code_[position].arg = arg;
+}
+
+uint32_t Chunk::GetPosition() const {
+    return code_.size();
+}
+
+uint32_t Chunk::AddConstant(ObjectPtr value) {
+    constants_.push_back(value);
+    return constants_.size() - 1;
+}
+
+uint32_t Chunk::AddSymbol(const SymbolPtr& symbol) {
+    for (size_t i = 0; i < symbols_.size(); ++i) {
+        if (symbols_[i] == symbol) {
+            return i;
+        }
+    }
+    symbols_.push_back(symbol);
+    global_caches_.emplace_back();
+    return symbols_.size() - 1;
+}
+
+uint32_t Chunk::AddLocal(const LocalAddress& address) {
+    locals_.push_back(address);
+    return locals_.size() - 1;
+}
+
+uint32_t Chunk::AddMessage(const std::string& message) {
+    messages_.push_back(message);
+    return messages_.size() - 1;
+}
+
+uint32_t Chunk::AddLambda(std::shared_ptr<LambdaNode> lambda) {
+    lambdas_.push_back(lambda);
+    return lambdas_.size() - 1;
+}
+
+const Instruction* Chunk::GetCode() const {
+    return code_.data();
+}
+
+const ObjectPtr& Chunk::GetConstant(uint32_t index) const {
+    return constants_[index];
+}
+
+const SymbolPtr& Chunk::GetSymbol(uint32_t index) const {
+    return symbols_[index];
+}
+
+ObjectPtr Chunk::LoadGlobal(uint32_t index, const Scope& globals) const {
+    return global_caches_[index].Get(globals, symbols_[index]);
+}
+
+const LocalAddress& Chunk::GetLocal(uint32_t index) const {
+    return locals_[index];
+}
+
+const std::string& Chunk::GetMessage(uint32_t index) const {
+    return messages_[index];
+}
+
+const std::shared_ptr<LambdaNode>& Chunk::GetLambda(uint32_t index) const {
+    return lambdas_[index];
+}
+
+std::shared_ptr<Chunk> Compile(const std::shared_ptr<Node>& program) {
+    auto chunk = std::make_shared<Chunk>();
+    program->Emit(chunk.get());
+    chunk->Emit(OpCode::kReturn);
+    return chunk;
+}
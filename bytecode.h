@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "object.h"
+#include "scope.h"
+
+class Node;
+class LambdaNode;
+
+enum class OpCode : uint8_t {
+    kConstant,          // push constants[arg]
+    kLoadLocal,         // push value of local variable locals[arg]
+    kLoadGlobal,        // push value of global variable symbols[arg]
+    kDefineLocal,       // pop value, store it in slot arg of the current frame, push ()
+    kDefineGlobal,      // pop value, define global symbols[arg], push ()
+    kSetLocal,          // pop value, set local variable locals[arg], push ()
+    kSetGlobal,         // pop value, set global variable symbols[arg], push ()
+    kPop,               // drop top of stack
+    kJump,              // pc = arg
+    kJumpIfFalse,       // pop condition, pc = arg if it is #f
+    kJumpIfFalseOrPop,  // pc = arg if top is #f, otherwise pop it
+    kJumpIfTrueOrPop,   // pc = arg if top is not #f, otherwise pop it
+    kJumpIfRedefined,   // pc = arg if a builtin used by constant folding was redefined
+    kClosure,           // push lambda created from lambdas[arg]
+    kCall,              // call function below arg arguments
+    kTailCall,          // same as kCall, replacing the current frame for lambdas
+    kReturn,            // return top of stack to the caller
+    kError,             // throw RuntimeError with messages[arg]
+};
+
+struct Instruction {
+    OpCode op;
+    uint32_t arg;
+};
+
+class Chunk {
+public:
+    size_t Emit(OpCode op, uint32_t arg = 0);
+    void Patch(size_t position, uint32_t arg);
+    uint32_t GetPosition() const;
+
+    uint32_t AddConstant(ObjectPtr value);
+    uint32_t AddSymbol(const SymbolPtr& symbol);
+    uint32_t AddLocal(const LocalAddress& address);
+    uint32_t AddMessage(const std::string& message);
+    uint32_t AddLambda(std::shared_ptr<LambdaNode> lambda);
+
+    const Instruction* GetCode() const;
+    const ObjectPtr& GetConstant(uint32_t index) const;
+    const SymbolPtr& GetSymbol(uint32_t index) const;
+    // Value of the global variable symbols[index], looked up through the
+    // inline cache of the symbol.
+    ObjectPtr LoadGlobal(uint32_t index, const Scope& globals) const;
+    const LocalAddress& GetLocal(uint32_t index) const;
+    const std::string& GetMessage(uint32_t index) const;
+    const std::shared_ptr<LambdaNode>& GetLambda(uint32_t index) const;
+
+private:
+    std::vector<Instruction> code_;
+    std::vector<ObjectPtr> constants_;
+    std::vector<SymbolPtr> symbols_;
+    std::vector<GlobalCache> global_caches_;
+    std::vector<LocalAddress> locals_;
+    std::vector<std::string> messages_;
+    std::vector<std::shared_ptr<LambdaNode>> lambdas_;
+};
+
+// Compiles a top-level node into a chunk that returns its value.
+std::shared_ptr<Chunk> Compile(const std::shared_ptr<Node>& program);
@@ -0,0 +1,216 @@
+#include "context.h"
+#include "allocator.h"
+#include "error.h"
+#include <algorithm>
+
+namespace {
+
+size_t GetObjectMemoryInUse() {
+    ObjectMemoryCounters counters = GetObjectMemoryCounters();
+    return counters.allocated_bytes - counters.freed_bytes;
+}
+
+}  // namespace
+
+Context::Context()
+    : root_(this),
+      collector_(new GarbageCollector()),
+      globals_(nullptr),
+      owned_globals_(std::make_unique<Scope>()) {
+    globals_ = owned_globals_.get();
+    ContextGuard guard(this);
+    globals_->InitGlobalScope();
+}
+
+Context::Context(Context* root, const TaskLimits& limits)
+    : root_(root->GetRoot()),
+      collector_(root->GetCollector()),
+      globals_(root->GetGlobals()),
+      limits_(limits.limits),
+      steps_(limits.steps),
+      deadline_(limits.deadline),
+      memory_baseline_(GetObjectMemoryInUse()),
+      max_call_depth_(limits_.depth.value_or(SIZE_MAX)) {
+    ScheduleLimitsCheck();
+}
+
+Context::~Context() {
+    if (root_ != this) {
+        return;
+    }
+    // Tasks still hold references into this interpreter. Nothing waits for
+    // their results any more, so they stop at their next limits check.
+    cancelled_.store(true);
+    for (size_t tasks = running_tasks_.load(); tasks > 0; tasks = running_tasks_.load()) {
+        running_tasks_.wait(tasks);
+    }
+    {
+        ContextGuard guard(this);
+        globals_->Clear();
+        current_frame_.reset();
+        pending_tail_call_ = TailCall();
+        collector_->Collect(GarbageCollector::kGenerations - 1);
+    }
+    // Objects that escaped the interpreter keep the collector alive.
+    collector_->Release();
+}
+
+Context* Context::GetRoot() {
+    return root_;
+}
+
+Scope* Context::GetGlobals() {
+    return globals_;
+}
+
+const std::shared_ptr<Frame>& Context::GetCurrentFrame() const {
+    return current_frame_;
+}
+
+void Context::SetCurrentFrame(std::shared_ptr<Frame> frame) {
+    current_frame_ = std::move(frame);
+}
+
+TailCall& Context::GetPendingTailCall() {
+    return pending_tail_call_;
+}
+
+void Context::StartLimits(const EvaluationLimits& limits) {
+    limits_ = limits;
+    steps_ = std::make_shared<std::atomic<uint64_t>>(0);
+    if (limits_.time) {
+        deadline_ = std::chrono::steady_clock::now() + *limits_.time;
+    }
+    memory_baseline_ = GetObjectMemoryInUse();
+    // Calls already in progress do not count.
+    max_call_depth_ =
+        (limits_.depth ? call_depth_ + std::min(*limits_.depth, SIZE_MAX - call_depth_) : SIZE_MAX);
+    ScheduleLimitsCheck();
+}
+
+TaskLimits Context::GetTaskLimits() const {
+    return TaskLimits{limits_, deadline_, steps_};
+}
+
+void Context::CheckLimits() {
+    uint64_t steps = steps_->fetch_add(steps_scheduled_) + steps_scheduled_;
+    if (limits_.fuel && steps > *limits_.fuel) {
+        throw LimitError("Evaluation ran out of fuel after " + std::to_string(*limits_.fuel) +
+                         " calls");
+    }
+    CheckDeadline();
+    if (limits_.memory && GetMemoryUsed() > *limits_.memory) {
+        ThrowMemoryLimit();
+    }
+    ScheduleLimitsCheck();
+}
+
+void Context::CheckDeadline() {
+    if (root_->cancelled_.load()) {
+        throw LimitError("Evaluation was cancelled");
+    }
+    if (limits_.time && std::chrono::steady_clock::now() >= deadline_) {
+        throw LimitError("Evaluation exceeded its time limit");
+    }
+}
+
+void Context::CheckAllocation(size_t count, size_t size) {
+    if (!limits_.memory) {
+        return;
+    }
+    size_t memory = GetMemoryUsed();
+    if (memory > *limits_.memory || count > (*limits_.memory - memory) / size) {
+        ThrowMemoryLimit();
+    }
+}
+
+size_t Context::GetMemoryUsed() const {
+    // The counters wrap around if other threads freed objects made here.
+    size_t memory = GetObjectMemoryInUse() - memory_baseline_;
+    return (memory <= SIZE_MAX / 2 ? memory : 0);
+}
+
+size_t Context::GetCallDepth() const {
+    return call_depth_;
+}
+
+void Context::SetCallDepth(size_t depth) {
+    call_depth_ = depth;
+}
+
+void Context::ThrowDepthLimit() {
+    --call_depth_;
+    throw LimitError("Evaluation exceeded its call depth limit of " +
+                     std::to_string(*limits_.depth));
+}
+
+void Context::ThrowMemoryLimit() const {
+    throw LimitError("Evaluation exceeded its memory limit of " +
+                     std::to_string(*limits_.memory) + " bytes");
+}
+
+void Context::ScheduleLimitsCheck() {
+    if (root_ == this && !limits_.fuel && !limits_.time && !limits_.memory) {
+        steps_until_check_ = UINT64_MAX;
+        return;
+    }
+    steps_scheduled_ = kLimitsCheckInterval;
+    // Check exactly at the call that exceeds the fuel. Tasks may have used
+    // it up already.
+    if (limits_.fuel) {
+        uint64_t steps = steps_->load();
+        uint64_t left = (steps < *limits_.fuel ? *limits_.fuel - steps : 0);
+        steps_scheduled_ = std::min(steps_scheduled_, left + 1);
+    }
+    steps_until_check_ = steps_scheduled_;
+}
+
+Profiler* Context::GetProfiler() const {
+    return profiler_;
+}
+
+void Context::SetProfiler(Profiler* profiler) {
+    profiler_ = profiler;
+}
+
+GarbageCollector* Context::GetCollector() {
+    return collector_;
+}
+
+void Context::MaybeCollectGarbage() {
+    if (root_ == this && !HasRunningTasks()) {
+        globals_->ReleaseRetired();
+        collector_->MaybeCollect();
+    }
+}
+
+void Context::BeginTask() {
+    if (root_ != this) {
+        root_->BeginTask();
+        return;
+    }
+    collector_->Share();
+    running_tasks_.fetch_add(1);
+}
+
+void Context::EndTask() {
+    if (root_ != this) {
+        root_->EndTask();
+        return;
+    }
+    if (running_tasks_.fetch_sub(1) == 1) {
+        running_tasks_.notify_all();
+    }
+}
+
+bool Context::HasRunningTasks() const {
+    return running_tasks_.load() > 0;
+}
+
+ContextGuard::ContextGuard(Context* context)
+    : previous_(GarbageCollector::SetCurrent(context->GetCollector())) {
+}
+
+ContextGuard::~ContextGuard() {
+    GarbageCollector::SetCurrent(previous_);
+}
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include "gc.h"
+#include "eval_limits.h"
+#include "object.h"
+#include "profiler.h"
+#include "scope.h"
+
+// A call in tail position hands its callee and arguments to the CallLambda
+// loop that runs the enclosing body instead of calling it directly.
+struct TailCall {
+    std::shared_ptr<Lambda> lambda;
+    std::vector<ObjectPtr> args;
+};
+
+// Limits of a running evaluation, for the tasks it spawns.
+struct TaskLimits {
+    EvaluationLimits limits;
+    std::chrono::steady_clock::time_point deadline;
+    // Calls made so far, shared by the evaluation and all of its tasks.
+    std::shared_ptr<std::atomic<uint64_t>> steps;
+};
+
+// Evaluation state of one interpreter. Running code gets it passed down
+// explicitly, so interpreters on different threads share nothing mutable.
+//
+// Parallel tasks of an interpreter run with contexts of their own that share
+// the globals and the collector of the interpreter's root context but have
+// their own current frame.
+class Context {
+public:
+    Context();
+    // Context of a task under the limits of the evaluation that spawned it.
+    Context(Context* root, const TaskLimits& limits);
+    // Waits for the tasks of the interpreter, which are cancelled first.
+    ~Context();
+
+    Context(const Context&) = delete;
+    Context& operator=(const Context&) = delete;
+
+    Context* GetRoot();
+    Scope* GetGlobals();
+
+    const std::shared_ptr<Frame>& GetCurrentFrame() const;
+    void SetCurrentFrame(std::shared_ptr<Frame> frame);
+
+    TailCall& GetPendingTailCall();
+
+    // Applies limits to the evaluation starting now, replacing the previous
+    // ones.
+    void StartLimits(const EvaluationLimits& limits);
+
+    // Tasks spawned now run until the deadline of the evaluation and draw on
+    // its fuel. Their memory and depth are limited like its own, but
+    // separately.
+    TaskLimits GetTaskLimits() const;
+
+    // Counts a procedure call. Limits are checked every kLimitsCheckInterval
+    // calls, so that the clock is not read on every call. Task contexts
+    // always check, so that they see when they are cancelled.
+    void CountStep() {
+        if (--steps_until_check_ == 0) {
+            CheckLimits();
+        }
+    }
+
+    // A call that is not a tail call starts with EnterCall and ends with
+    // LeaveCall. EnterCall raises LimitError beyond the depth limit.
+    void EnterCall() {
+        if (++call_depth_ > max_call_depth_) {
+            ThrowDepthLimit();
+        }
+    }
+    void LeaveCall() {
+        --call_depth_;
+    }
+    // Restores the depth saved before a call that raised an error.
+    size_t GetCallDepth() const;
+    void SetCallDepth(size_t depth);
+
+    // Raises LimitError if allocating count objects of size bytes more would
+    // exceed the memory limit. Called before allocations sized by the
+    // program, which the periodic check would only see once they are made.
+    void CheckAllocation(size_t count, size_t size);
+
+    // Raises LimitError if the evaluation is past its time limit or was
+    // cancelled. Called before long operations that make no calls.
+    void CheckDeadline();
+
+    // Calls are reported to the profiler if there is one. Task contexts never
+    // have one, since the profiler is not thread-safe.
+    Profiler* GetProfiler() const;
+    void SetProfiler(Profiler* profiler);
+
+    // Objects created while the context is entered are tracked by its
+    // collector.
+    GarbageCollector* GetCollector();
+
+    // Collects cycles if enough objects were created, and frees the values
+    // the globals replaced. Only the root context does, and only while none
+    // of its tasks is running, because a collection must not see objects
+    // other threads are working on, and tasks may still read those values.
+    void MaybeCollectGarbage();
+
+    // Parallel tasks are counted from their creation until they have dropped
+    // all references to interpreter objects. The root context waits for them
+    // before it is destroyed.
+    void BeginTask();
+    void EndTask();
+    bool HasRunningTasks() const;
+
+private:
+    static constexpr uint64_t kLimitsCheckInterval = 1024;
+
+    void CheckLimits();
+    void ScheduleLimitsCheck();
+    // Growth of the object memory since the limits were started.
+    size_t GetMemoryUsed() const;
+    [[noreturn]] void ThrowMemoryLimit() const;
+    [[noreturn]] void ThrowDepthLimit();
+
+    Context* root_;
+    GarbageCollector* collector_;
+    Scope* globals_;
+    std::unique_ptr<Scope> owned_globals_;
+    std::atomic<size_t> running_tasks_ = 0;
+    std::atomic<bool> cancelled_ = false;
+    std::shared_ptr<Frame> current_frame_;
+    TailCall pending_tail_call_;
+    Profiler* profiler_ = nullptr;
+
+    EvaluationLimits limits_;
+    uint64_t steps_until_check_ = UINT64_MAX;
+    uint64_t steps_scheduled_ = 0;
+    std::shared_ptr<std::atomic<uint64_t>> steps_ = std::make_shared<std::atomic<uint64_t>>(0);
+    std::chrono::steady_clock::time_point deadline_;
+    size_t memory_baseline_ = 0;
+    size_t call_depth_ = 0;
+    size_t max_call_depth_ = SIZE_MAX;
+};
+
+// Makes the context's collector current on this thread for its lifetime.
+class ContextGuard {
+public:
+    explicit ContextGuard(Context* context);
+    ~ContextGuard();
+
+    ContextGuard(const ContextGuard&) = delete;
+    ContextGuard& operator=(const ContextGuard&) = delete;
+
+private:
+    GarbageCollector* previous_;
+};
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+// Limits of a single evaluation. Exceeding one raises LimitError; the
+// interpreter stays usable afterwards.
+struct EvaluationLimits {
+    // Number of procedure calls.
+    std::optional<uint64_t> fuel;
+    // Wall-clock time.
+    std::optional<std::chrono::steady_clock::duration> time;
+    // Growth of the object memory of the evaluating thread, in bytes.
+    std::optional<size_t> memory;
+    // Nesting of procedure calls that are not tail calls. The tree-walking
+    // mode takes around a kilobyte of the host's stack for each of them, so
+    // embedders should keep this well below what their stack can hold.
+    std::optional<size_t> depth;
+};
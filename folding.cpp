@@ -0,0 +1,73 @@
+#include "folding.h"
+#include "functions.h"
+#include "scope.h"
+#include <string_view>
+#include <unordered_set>
+
+namespace {
+
+const std::unordered_set<const Symbol*>& GetFoldableBuiltins() {
+    static const std::unordered_set<const Symbol*> kBuiltins = [] {
+        std::unordered_set<const Symbol*> builtins;
+        for (std::string_view name : {"+", "-", "*", "/", "min", "max", "abs", "<", ">", "<=",
+                                      ">=", "=", "not", "car", "cdr"}) {
+            builtins.insert(Intern(name).get());
+        }
+        return builtins;
+    }();
+    return kBuiltins;
+}
+
+// Builtins as InitGlobalScope defines them, called to fold at analysis time.
+// Never destroyed, like the symbol table.
+const Scope& GetBuiltins() {
+    static const Scope* kScope = [] {
+        auto scope = new Scope();
+        scope->InitGlobalScope();
+        return scope;
+    }();
+    return *kScope;
+}
+
+}  // namespace
+
+bool IsFoldableBuiltin(const Symbol* name) {
+    return GetFoldableBuiltins().contains(name);
+}
+
+NodePtr FoldCall(const SymbolPtr& name, const std::vector<NodePtr>& operands, NodePtr call) {
+    if (!IsFoldableBuiltin(name.get())) {
+        return call;
+    }
+    std::vector<ObjectPtr> args;
+    args.reserve(operands.size());
+    for (const NodePtr& operand : operands) {
+        const ObjectPtr* value = operand->GetConstantValue();
+        if (!value) {
+            return call;
+        }
+        args.push_back(*value);
+    }
+    ObjectPtr value;
+    try {
+        // The folded builtins are pure and do not use the context.
+        value = GetBuiltins().Get(name)->Apply(nullptr, args);
+    } catch (const std::runtime_error&) {
+        return call;
+    }
+    return std::make_shared<FoldedNode>(std::make_shared<ConstantNode>(value), std::move(call));
+}
+
+NodePtr FoldIf(const NodePtr& condition, const NodePtr& then_branch, const NodePtr& else_branch,
+               NodePtr if_node) {
+    const ObjectPtr* value = condition->GetConstantValue();
+    if (!value) {
+        return if_node;
+    }
+    NodePtr taken = (!IsFalse(*value) ? then_branch : else_branch);
+    if (!taken) {
+        taken = std::make_shared<ConstantNode>(nullptr);
+    }
+    // The condition itself may be a folded call.
+    return std::make_shared<FoldedNode>(std::move(taken), std::move(if_node));
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <vector>
+#include "analyzer.h"
+
+// Constant folding, done by the analysis pass while it builds nodes. Calls of
+// pure builtins whose operands are all constants are evaluated once, at
+// analysis time, and an if with a constant condition is replaced by the
+// branch it takes. The result is wrapped in a FoldedNode together with the
+// original code, which the scope switches back to once any of the folded
+// builtins is redefined by define or set!.
+
+// Whether calls of the global function name are folded.
+bool IsFoldableBuiltin(const Symbol* name);
+
+// Folds call, the call of the global function name with the given operands.
+// Returns call itself if it cannot be folded, including when it would raise
+// an error: that is left to happen at run time.
+NodePtr FoldCall(const SymbolPtr& name, const std::vector<NodePtr>& operands, NodePtr call);
+
+// Replaces if_node by its taken branch if condition is a constant.
+NodePtr FoldIf(const NodePtr& condition, const NodePtr& then_branch, const NodePtr& else_branch,
+               NodePtr if_node);
@@ -1,187 +1,285 @@
 #include "functions.h"
-#include "scope.h"
+#include "context.h"
+#include <cmath>
+#include <cstdlib>
 #include <utility>
 
-// Object functions
-
-ObjectPtr LambdaFunction::Apply(ObjectPtr obj) {
-    std::vector<ObjectPtr> args = GetArgList(obj);
-    CheckArgumentsCount<SyntaxError>(args, 2);
-    if (!IsCorrectList(args[0])) {
-        throw SyntaxError("Wrong lambda syntax");
-    }
-    return std::make_shared<Lambda>(As<Cell>(obj)->GetSecond(), GetSymbolsList(args[0]),
-                                    GetCurrentScope());
-}
+namespace {
 
-ObjectPtr IfFunction::Apply(ObjectPtr obj) {
-    std::vector<ObjectPtr> args = GetArgList(obj);
-    CheckArgumentsCount<SyntaxError>(args, 2, 3);
-    args[0] = args[0]->Evaluate();
-    if (!IsFalse(args[0])) {
-        return args[1]->Evaluate();
-    } else if (args.size() == 2) {
-        return nullptr;
-    } else {
-        return args[2]->Evaluate();
-    }
-}
+// Walking a list counts a step every this many cells, since a cyclic list
+// can be walked forever.
+constexpr size_t kListCellsPerStep = 256;
+// Operations on big integers this long check the time limit first.
+constexpr size_t kLongBigIntegerLimbs = 256;
 
-ObjectPtr SetFunction::Apply(ObjectPtr obj) {
-    std::vector<ObjectPtr> args = GetArgList(obj);
-    CheckArgumentsCount<SyntaxError>(args, 2, 2);
-    if (!IsSymbol(args[0])) {
-        throw RuntimeError("Name of variable should be Symbol");
-    }
-    args[1] = args[1]->Evaluate();
-    GetCurrentScope()->Set(As<Symbol>(args[0])->GetName(), args[1]);
-    return nullptr;
-}
+}  // namespace
 
-ObjectPtr DefineFunction::Apply(ObjectPtr obj) {
-    std::vector<ObjectPtr> args = GetArgList(obj);
-    CheckArgumentsCount<SyntaxError>(args, 2);
-    if (IsSymbol(args[0])) {
-        if (args.size() > 2) {
-            throw SyntaxError("Define expects 2 arguments, got " + std::to_string(args.size()));
-        }
-        args[1] = args[1]->Evaluate();
-        GetCurrentScope()->Define(As<Symbol>(args[0])->GetName(), args[1]);
-    } else if (IsCorrectList(args[0])) {
-        if (auto name_ptr = GetHeadFromList(args[0]); Is<Symbol>(name_ptr)) {
-            std::string lambda_name = As<Symbol>(name_ptr)->GetName();
-            ObjectPtr init_list = GetTailFromList(args[0]);
-            ObjectPtr lambda = std::make_shared<Lambda>(
-                GetTailFromList(obj), GetSymbolsList(init_list), GetCurrentScope());
-            GetCurrentScope()->Define(lambda_name, lambda);
-        } else {
-            throw RuntimeError("Name of Lambda should be Symbol");
-        }
-    } else {
-        throw RuntimeError("First argument of define should be Symbol or Lambda declaration");
-    }
-    return nullptr;
-}
-
-ObjectPtr QuoteFunction::Apply(ObjectPtr obj) {
-    std::vector<ObjectPtr> args = GetArgList(obj);
-    CheckArgumentsCount<RuntimeError>(args, 1, 1);
-    return args[0];
-}
+// Object functions
 
-ObjectPtr IsFunction::Apply(ObjectPtr obj) {
-    std::vector<ObjectPtr> args = GetArgList(obj);
+ObjectPtr IsFunction::Apply(Context*, const std::vector<ObjectPtr>& args) {
     CheckArgumentsCount<RuntimeError>(args, 1, 1);
-    EvaluateArgs(args);
     return GetBoolean(predicate_(args[0]));
 }
 
-ObjectPtr ConsFunction::Apply(ObjectPtr obj) {
-    std::vector<ObjectPtr> args = GetArgList(obj);
+ObjectPtr ConsFunction::Apply(Context*, const std::vector<ObjectPtr>& args) {
     CheckArgumentsCount<RuntimeError>(args, 2, 2);
-    EvaluateArgs(args);
-    ObjectPtr pair = std::make_shared<Cell>();
-    As<Cell>(pair)->GetFirst() = args[0];
-    As<Cell>(pair)->GetSecond() = args[1];
+    ObjectPtr pair = MakeObject<Cell>();
+    Cast<Cell>(pair)->GetFirst() = args[0];
+    Cast<Cell>(pair)->GetSecond() = args[1];
     return pair;
 }
 
-ObjectPtr CarFunction::Apply(ObjectPtr obj) {
-    std::vector<ObjectPtr> args = GetArgList(obj);
+ObjectPtr CarFunction::Apply(Context*, const std::vector<ObjectPtr>& args) {
     CheckArgumentsCount<RuntimeError>(args, 1, 1);
-    EvaluateArgs(args);
     return GetHeadFromList(args[0]);
 }
 
-ObjectPtr SetCarFunction::Apply(ObjectPtr obj) {
-    std::vector<ObjectPtr> args = GetArgList(obj);
+ObjectPtr SetCarFunction::Apply(Context*, const std::vector<ObjectPtr>& args) {
     CheckArgumentsCount<SyntaxError>(args, 2, 2);
-    EvaluateArgs(args);
     if (!Is<Cell>(args[0])) {
         throw RuntimeError("set-car! first argument is not a list");
     }
-    As<Cell>(args[0])->GetFirst() = args[1];
+    Cast<Cell>(args[0])->GetFirst() = args[1];
     return nullptr;
 }
 
-ObjectPtr SetCdrFunction::Apply(ObjectPtr obj) {
-    std::vector<ObjectPtr> args = GetArgList(obj);
+ObjectPtr SetCdrFunction::Apply(Context*, const std::vector<ObjectPtr>& args) {
     CheckArgumentsCount<SyntaxError>(args, 2, 2);
-    EvaluateArgs(args);
     if (!Is<Cell>(args[0])) {
         throw RuntimeError("set-cdr! first argument is not a list");
     }
-    As<Cell>(args[0])->GetSecond() = args[1];
+    Cast<Cell>(args[0])->GetSecond() = args[1];
     return nullptr;
 }
 
-ObjectPtr CdrFunction::Apply(ObjectPtr obj) {
-    std::vector<ObjectPtr> args = GetArgList(obj);
+ObjectPtr CdrFunction::Apply(Context*, const std::vector<ObjectPtr>& args) {
     CheckArgumentsCount<RuntimeError>(args, 1, 1);
-    EvaluateArgs(args);
     return GetTailFromList(args[0]);
 }
 
-ObjectPtr ListFunction::Apply(ObjectPtr obj) {
-    std::vector<ObjectPtr> args = GetArgList(obj);
-    EvaluateArgs(args);
+ObjectPtr ListFunction::Apply(Context*, const std::vector<ObjectPtr>& args) {
     return GetListFromArgs(args);
 }
 
-ObjectPtr ListTailFunction::Apply(ObjectPtr obj) {
-    std::vector<ObjectPtr> args = GetArgList(obj);
+ObjectPtr ListTailFunction::Apply(Context* context, const std::vector<ObjectPtr>& args) {
     CheckArgumentsCount<RuntimeError>(args, 2, 2);
-    EvaluateArgs(args);
     if (!Is<Number>(args[1])) {
         throw RuntimeError("Second argument should be Number");
     }
-    return GetListTailFromKthElement(args[0], As<Number>(args[1])->GetValue());
+    return GetListTailFromKthElement(args[0], Cast<Number>(args[1])->GetValue(), context);
 }
 
-ObjectPtr ListRefFunction::Apply(ObjectPtr obj) {
-    std::vector<ObjectPtr> args = GetArgList(obj);
+ObjectPtr ListRefFunction::Apply(Context* context, const std::vector<ObjectPtr>& args) {
     CheckArgumentsCount<RuntimeError>(args, 2, 2);
-    EvaluateArgs(args);
     if (!Is<Number>(args[1])) {
         throw RuntimeError("Second argument should be Number");
     }
-    return GetListKthElement(args[0], As<Number>(args[1])->GetValue());
+    return GetListKthElement(args[0], Cast<Number>(args[1])->GetValue(), context);
 }
 
-ObjectPtr AbsFunction::Apply(ObjectPtr obj) {
-    std::vector<ObjectPtr> args = GetArgList(obj);
+ObjectPtr AbsFunction::Apply(Context*, const std::vector<ObjectPtr>& args) {
     CheckArgumentsCount<RuntimeError>(args, 1, 1);
-    EvaluateArgs(args);
-    if (!IsAll<Number>(args)) {
+    if (!IsAll<RealNumber>(args)) {
         throw RuntimeError("Argument of abs function should be number");
     }
-    return std::make_shared<Number>(As<Number>(args[0])->GetValue() >= 0
-                                        ? As<Number>(args[0])->GetValue()
-                                        : -As<Number>(args[0])->GetValue());
+    if (const Real* real = Cast<Real>(args[0])) {
+        return MakeObject<Real>(std::fabs(real->GetValue()));
+    }
+    if (const Number* number = Cast<Number>(args[0]); number && number->GetValue() != INT64_MIN) {
+        return MakeNumber(std::abs(number->GetValue()));
+    }
+    return MakeInteger(GetBigInteger(args[0]).Abs());
+}
+
+void CheckBigIntegerOperation(Context* context, size_t limbs) {
+    context->CheckAllocation(limbs, sizeof(uint32_t));
+    if (limbs >= kLongBigIntegerLimbs) {
+        context->CheckDeadline();
+    }
+}
+
+// Vector and numeric vector helpers
+
+namespace {
+
+Vector* GetVector(const ObjectPtr& obj, const char* function) {
+    Vector* vector = Cast<Vector>(obj);
+    if (!vector) {
+        throw RuntimeError(std::string("First argument of ") + function + " should be vector");
+    }
+    return vector;
+}
+
+NumericVector* GetNumericVector(const ObjectPtr& obj, const char* function) {
+    NumericVector* vector = Cast<NumericVector>(obj);
+    if (!vector) {
+        throw RuntimeError(std::string("First argument of ") + function +
+                           " should be f64vector");
+    }
+    return vector;
+}
+
+double GetElement(const ObjectPtr& obj, const char* function) {
+    if (!Is<RealNumber>(obj)) {
+        throw RuntimeError(std::string("Elements of ") + function + " should be numbers");
+    }
+    return GetDouble(obj);
+}
+
+size_t GetSize(const ObjectPtr& obj, const char* function) {
+    const Number* size = Cast<Number>(obj);
+    if (!size || size->GetValue() < 0) {
+        throw RuntimeError(std::string("Size of ") + function +
+                           " should be a non-negative number");
+    }
+    return size->GetValue();
+}
+
+size_t GetIndex(const ObjectPtr& obj, size_t size, const char* function) {
+    const Number* index = Cast<Number>(obj);
+    if (!index || index->GetValue() < 0 || static_cast<uint64_t>(index->GetValue()) >= size) {
+        throw RuntimeError(std::string("Index of ") + function + " is out of range");
+    }
+    return index->GetValue();
+}
+
+}  // namespace
+
+// Vector functions
+
+ObjectPtr VectorFunction::Apply(Context*, const std::vector<ObjectPtr>& args) {
+    return MakeObject<Vector>(args);
+}
+
+ObjectPtr MakeVectorFunction::Apply(Context* context, const std::vector<ObjectPtr>& args) {
+    CheckArgumentsCount<RuntimeError>(args, 1, 2);
+    size_t size = GetSize(args[0], "make-vector");
+    context->CheckAllocation(size, sizeof(ObjectPtr));
+    ObjectPtr fill = (args.size() == 2 ? args[1] : nullptr);
+    return MakeObject<Vector>(std::vector<ObjectPtr>(size, fill));
+}
+
+ObjectPtr VectorLengthFunction::Apply(Context*, const std::vector<ObjectPtr>& args) {
+    CheckArgumentsCount<RuntimeError>(args, 1, 1);
+    return MakeNumber(GetVector(args[0], "vector-length")->GetElements().size());
+}
+
+ObjectPtr VectorRefFunction::Apply(Context*, const std::vector<ObjectPtr>& args) {
+    CheckArgumentsCount<RuntimeError>(args, 2, 2);
+    const std::vector<ObjectPtr>& elements = GetVector(args[0], "vector-ref")->GetElements();
+    return elements[GetIndex(args[1], elements.size(), "vector-ref")];
+}
+
+ObjectPtr VectorSetFunction::Apply(Context*, const std::vector<ObjectPtr>& args) {
+    CheckArgumentsCount<RuntimeError>(args, 3, 3);
+    std::vector<ObjectPtr>& elements = GetVector(args[0], "vector-set!")->GetElements();
+    elements[GetIndex(args[1], elements.size(), "vector-set!")] = args[2];
+    return nullptr;
+}
+
+ObjectPtr VectorFillFunction::Apply(Context*, const std::vector<ObjectPtr>& args) {
+    CheckArgumentsCount<RuntimeError>(args, 2, 2);
+    std::vector<ObjectPtr>& elements = GetVector(args[0], "vector-fill!")->GetElements();
+    std::fill(elements.begin(), elements.end(), args[1]);
+    return nullptr;
+}
+
+ObjectPtr VectorCopyFunction::Apply(Context*, const std::vector<ObjectPtr>& args) {
+    CheckArgumentsCount<RuntimeError>(args, 1, 1);
+    return MakeObject<Vector>(GetVector(args[0], "vector-copy")->GetElements());
+}
+
+ObjectPtr VectorToListFunction::Apply(Context*, const std::vector<ObjectPtr>& args) {
+    CheckArgumentsCount<RuntimeError>(args, 1, 1);
+    return GetListFromArgs(GetVector(args[0], "vector->list")->GetElements());
+}
+
+ObjectPtr ListToVectorFunction::Apply(Context* context, const std::vector<ObjectPtr>& args) {
+    CheckArgumentsCount<RuntimeError>(args, 1, 1);
+    std::optional<size_t> length = GetListLength(args[0]);
+    if (!length) {
+        throw RuntimeError("Argument of list->vector should be a list");
+    }
+    context->CheckAllocation(*length, sizeof(ObjectPtr));
+    std::vector<ObjectPtr> elements;
+    elements.reserve(*length);
+    const ObjectPtr* current = &args[0];
+    for (; *current; current = &Cast<Cell>(*current)->GetSecond()) {
+        elements.push_back(Cast<Cell>(*current)->GetFirst());
+    }
+    return MakeObject<Vector>(std::move(elements));
+}
+
+// Numeric vector functions
+
+bool IsNumericVector(ObjectPtr obj) {
+    return Is<NumericVector>(obj);
+}
+
+ObjectPtr NumericVectorFunction::Apply(Context*, const std::vector<ObjectPtr>& args) {
+    std::vector<double> values;
+    values.reserve(args.size());
+    for (const auto& arg : args) {
+        values.push_back(GetElement(arg, "f64vector"));
+    }
+    return MakeObject<NumericVector>(std::move(values));
+}
+
+ObjectPtr MakeNumericVectorFunction::Apply(Context* context, const std::vector<ObjectPtr>& args) {
+    CheckArgumentsCount<RuntimeError>(args, 1, 2);
+    size_t size = GetSize(args[0], "make-f64vector");
+    context->CheckAllocation(size, sizeof(double));
+    double fill = (args.size() == 2 ? GetElement(args[1], "make-f64vector") : 0);
+    return MakeObject<NumericVector>(std::vector<double>(size, fill));
+}
+
+ObjectPtr NumericVectorLengthFunction::Apply(Context*, const std::vector<ObjectPtr>& args) {
+    CheckArgumentsCount<RuntimeError>(args, 1, 1);
+    return MakeNumber(GetNumericVector(args[0], "f64vector-length")->GetValues().size());
+}
+
+ObjectPtr NumericVectorRefFunction::Apply(Context*, const std::vector<ObjectPtr>& args) {
+    CheckArgumentsCount<RuntimeError>(args, 2, 2);
+    const std::vector<double>& values = GetNumericVector(args[0], "f64vector-ref")->GetValues();
+    return MakeObject<Real>(values[GetIndex(args[1], values.size(), "f64vector-ref")]);
+}
+
+ObjectPtr NumericVectorSetFunction::Apply(Context*, const std::vector<ObjectPtr>& args) {
+    CheckArgumentsCount<RuntimeError>(args, 3, 3);
+    std::vector<double>& values = GetNumericVector(args[0], "f64vector-set!")->GetValues();
+    values[GetIndex(args[1], values.size(), "f64vector-set!")] =
+        GetElement(args[2], "f64vector-set!");
+    return nullptr;
+}
+
+ObjectPtr NumericVectorSumFunction::Apply(Context*, const std::vector<ObjectPtr>& args) {
+    CheckArgumentsCount<RuntimeError>(args, 1, 1);
+    return MakeObject<Real>(SumVector(GetNumericVector(args[0], "f64vector-sum")->GetValues()));
 }
 
 // Helpers
 
-std::vector<std::string> GetSymbolsList(ObjectPtr obj) {
+std::vector<SymbolPtr> GetSymbolsList(ObjectPtr obj) {
     std::vector<ObjectPtr> args = GetArgList(obj);
-    std::vector<std::string> vars;
+    std::vector<SymbolPtr> vars;
     for (auto a : args) {
         if (!Is<Symbol>(a)) {
             throw SyntaxError("Lambda parameters should be Symbols");
         }
-        vars.push_back(As<Symbol>(a)->GetName());
+        vars.push_back(As<Symbol>(a));
     }
     return vars;
 }
 
 std::vector<ObjectPtr> GetArgList(ObjectPtr obj) {
+    std::optional<size_t> length = GetListLength(obj);
+    if (!length) {
+        throw SyntaxError("");
+    }
     std::vector<ObjectPtr> list;
-    while (obj) {
-        if (!Is<Cell>(obj)) {
-            throw SyntaxError("");
-        }
-        list.push_back(As<Cell>(obj)->GetFirst());
-        obj = As<Cell>(obj)->GetSecond();
+    list.reserve(*length);
+    for (const ObjectPtr* current = &obj; *current; current = &Cast<Cell>(*current)->GetSecond()) {
+        list.push_back(Cast<Cell>(*current)->GetFirst());
     }
     return list;
 }
@@ -190,69 +288,88 @@ ObjectPtr GetHeadFromList(ObjectPtr obj) {
     if (!obj || !Is<Cell>(obj)) {
         throw RuntimeError("");
     }
-    return As<Cell>(obj)->GetFirst();
+    return Cast<Cell>(obj)->GetFirst();
 }
 
 ObjectPtr GetTailFromList(ObjectPtr obj) {
     if (!obj || !Is<Cell>(obj)) {
         throw RuntimeError("");
     }
-    return As<Cell>(obj)->GetSecond();
+    return Cast<Cell>(obj)->GetSecond();
 }
 
-ObjectPtr GetListTailFromKthElement(ObjectPtr obj, size_t k) {
+ObjectPtr GetListTailFromKthElement(ObjectPtr obj, size_t k, Context* context) {
     for (size_t i = 0; i < k; ++i) {
         if (!obj || !Is<Cell>(obj)) {
             throw RuntimeError("");
         }
-        obj = As<Cell>(obj)->GetSecond();
+        if ((i + 1) % kListCellsPerStep == 0 && context) {
+            context->CountStep();
+        }
+        obj = Cast<Cell>(obj)->GetSecond();
     }
     return obj;
 }
 
-ObjectPtr GetListKthElement(ObjectPtr obj, size_t k) {
-    ObjectPtr tail = GetListTailFromKthElement(obj, k);
+ObjectPtr GetListKthElement(ObjectPtr obj, size_t k, Context* context) {
+    ObjectPtr tail = GetListTailFromKthElement(obj, k, context);
     if (!tail) {
         throw RuntimeError("Index error");
     }
     return GetHeadFromList(tail);
 }
 
-ObjectPtr GetBoolean(bool value) {
-    return (value ? std::make_shared<Symbol>("#t") : std::make_shared<Symbol>("#f"));
+const ObjectPtr& GetBoolean(bool value) {
+    static const ObjectPtr kTrue = Intern("#t");
+    static const ObjectPtr kFalse = Intern("#f");
+    return (value ? kTrue : kFalse);
 }
 
 ObjectPtr GetListFromArgs(const std::vector<ObjectPtr>& args) {
     if (args.empty()) {
         return nullptr;
     }
-    ObjectPtr root = std::make_shared<Cell>();
+    ObjectPtr root = MakeObject<Cell>();
     ObjectPtr v = root;
     for (size_t i = 0; i < args.size(); ++i) {
-        As<Cell>(v)->GetFirst() = args[i];
+        Cast<Cell>(v)->GetFirst() = args[i];
         if (i != args.size() - 1) {
-            As<Cell>(v)->GetSecond() = std::make_shared<Cell>();
-            v = As<Cell>(v)->GetSecond();
+            Cast<Cell>(v)->GetSecond() = MakeObject<Cell>();
+            v = Cast<Cell>(v)->GetSecond();
         }
     }
     return root;
 }
 
-void EvaluateArgs(std::vector<ObjectPtr>& args_list) {
-    std::vector<ObjectPtr> evaluated_list;
-    for (auto& a : args_list) {
-        if (!a) {
-            throw RuntimeError("Empty is not evaluatable");
+// The second pointer walks two cells at a time, so it meets the first one
+// inside a cycle.
+std::optional<size_t> GetListLength(const ObjectPtr& obj) {
+    const Object* slow = obj.get();
+    const Object* fast = obj.get();
+    for (size_t length = 0;; length += 2) {
+        if (!fast) {
+            return length;
+        }
+        if (fast->GetType() != ObjectType::kCell) {
+            return std::nullopt;
+        }
+        fast = static_cast<const Cell*>(fast)->GetSecond().get();
+        if (!fast) {
+            return length + 1;
+        }
+        if (fast->GetType() != ObjectType::kCell) {
+            return std::nullopt;
+        }
+        fast = static_cast<const Cell*>(fast)->GetSecond().get();
+        slow = static_cast<const Cell*>(slow)->GetSecond().get();
+        if (fast == slow) {
+            return std::nullopt;
         }
-        a = a->Evaluate();
     }
 }
 
 bool IsCorrectList(ObjectPtr obj) {
-    while (obj && Is<Cell>(obj)) {
-        obj = As<Cell>(obj)->GetSecond();
-    }
-    return (obj.get() == nullptr);
+    return GetListLength(obj).has_value();
 }
 
 bool IsPair(ObjectPtr obj) {
@@ -263,8 +380,12 @@ bool IsNull(ObjectPtr obj) {
     return obj.get() == nullptr;
 }
 
+bool IsVector(ObjectPtr obj) {
+    return Is<Vector>(obj);
+}
+
 bool IsNumber(ObjectPtr obj) {
-    return (!IsNull(obj) && Is<Number>(obj));
+    return (!IsNull(obj) && Is<RealNumber>(obj));
 }
 
 bool IsSymbol(ObjectPtr obj) {
@@ -272,20 +393,9 @@ bool IsSymbol(ObjectPtr obj) {
 }
 
 bool IsBoolean(ObjectPtr obj) {
-    return (!IsNull(obj) && Is<Symbol>(obj) &&
-            (As<Symbol>(obj)->GetName() == "#t" || As<Symbol>(obj)->GetName() == "#f"));
-}
-
-template <typename T>
-bool IsAll(const std::vector<ObjectPtr>& args) {
-    for (auto i : args) {
-        if (!Is<T>(i)) {
-            return false;
-        }
-    }
-    return true;
+    return (obj == GetBoolean(true) || obj == GetBoolean(false));
 }
 
 bool IsFalse(ObjectPtr obj) {
-    return (IsBoolean(obj) && As<Symbol>(obj)->GetName() == "#f");
+    return obj == GetBoolean(false);
 }
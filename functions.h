@@ -1,15 +1,17 @@
 #pragma once
 
+#include <algorithm>
 #include <optional>
 #include <vector>
 #include <unordered_map>
 #include <string>
 #include "object.h"
 #include "error.h"
+#include "simd.h"
 
 // Helpers
 
-std::vector<std::string> GetSymbolsList(ObjectPtr obj);
+std::vector<SymbolPtr> GetSymbolsList(ObjectPtr obj);
 
 std::vector<ObjectPtr> GetArgList(ObjectPtr obj);
 
@@ -17,15 +19,14 @@ ObjectPtr GetHeadFromList(ObjectPtr obj);
 
 ObjectPtr GetTailFromList(ObjectPtr obj);
 
-ObjectPtr GetListTailFromKthElement(ObjectPtr obj, size_t k);
+// Walking the list counts steps of context, if given.
+ObjectPtr GetListTailFromKthElement(ObjectPtr obj, size_t k, Context* context = nullptr);
 
-ObjectPtr GetListKthElement(ObjectPtr obj, size_t k);
+ObjectPtr GetListKthElement(ObjectPtr obj, size_t k, Context* context = nullptr);
 
 ObjectPtr GetListFromArgs(const std::vector<ObjectPtr>& args);
 
-ObjectPtr GetBoolean(bool value);
-
-void EvaluateArgs(std::vector<ObjectPtr>& args_list);
+const ObjectPtr& GetBoolean(bool value);
 
 template <typename Error>
 void CheckArgumentsCount(const std::vector<ObjectPtr>& args_list, size_t min_count = 0,
@@ -37,12 +38,19 @@ void CheckArgumentsCount(const std::vector<ObjectPtr>& args_list, size_t min_cou
                 " arguments, got " + std::to_string(args_list.size()));
 }
 
+// Number of elements of obj, or nothing if obj is not a list: it is improper
+// or cyclic.
+std::optional<size_t> GetListLength(const ObjectPtr& obj);
+
+// Cyclic lists are not lists.
 bool IsCorrectList(ObjectPtr obj);
 
 bool IsPair(ObjectPtr obj);
 
 bool IsNull(ObjectPtr obj);
 
+bool IsVector(ObjectPtr obj);
+
 bool IsNumber(ObjectPtr obj);
 
 bool IsSymbol(ObjectPtr obj);
@@ -52,185 +60,405 @@ bool IsBoolean(ObjectPtr obj);
 bool IsFalse(ObjectPtr obj);
 
 template <typename T>
-bool IsAll(const std::vector<ObjectPtr>& args);
+bool IsAll(const std::vector<ObjectPtr>& args) {
+    for (const auto& i : args) {
+        if (!Is<T>(i)) {
+            return false;
+        }
+    }
+    return true;
+}
 
 // Universal functions
 
-class LambdaFunction : public Function {
-public:
-    ObjectPtr Apply(ObjectPtr obj) override;
-};
-
-class IfFunction : public Function {
-public:
-    ObjectPtr Apply(ObjectPtr obj) override;
-};
-
-class QuoteFunction : public Function {
-public:
-    ObjectPtr Apply(ObjectPtr obj) override;
-};
-
 class IsFunction : public Function {
 public:
     template <class F>
     explicit IsFunction(F&& f) : predicate_(f) {
     }
 
-    ObjectPtr Apply(ObjectPtr obj) override;
+    ObjectPtr Apply(Context* context, const std::vector<ObjectPtr>& args) override;
 
 private:
     bool (*predicate_)(ObjectPtr obj);
 };
 
-class DefineFunction : public Function {
-public:
-    ObjectPtr Apply(ObjectPtr obj) override;
-};
-
-class SetFunction : public Function {
-public:
-    ObjectPtr Apply(ObjectPtr obj) override;
-};
-
 // List functions
 
 class ConsFunction : public Function {
 public:
-    ObjectPtr Apply(ObjectPtr obj) override;
+    ObjectPtr Apply(Context* context, const std::vector<ObjectPtr>& args) override;
 };
 
 class CarFunction : public Function {
 public:
-    ObjectPtr Apply(ObjectPtr obj) override;
+    ObjectPtr Apply(Context* context, const std::vector<ObjectPtr>& args) override;
 };
 
 class CdrFunction : public Function {
 public:
-    ObjectPtr Apply(ObjectPtr obj) override;
+    ObjectPtr Apply(Context* context, const std::vector<ObjectPtr>& args) override;
 };
 
 class ListFunction : public Function {
 public:
-    ObjectPtr Apply(ObjectPtr obj) override;
+    ObjectPtr Apply(Context* context, const std::vector<ObjectPtr>& args) override;
 };
 
 class ListTailFunction : public Function {
 public:
-    ObjectPtr Apply(ObjectPtr obj) override;
+    ObjectPtr Apply(Context* context, const std::vector<ObjectPtr>& args) override;
 };
 
 class ListRefFunction : public Function {
 public:
-    ObjectPtr Apply(ObjectPtr obj) override;
+    ObjectPtr Apply(Context* context, const std::vector<ObjectPtr>& args) override;
 };
 
 class SetCarFunction : public Function {
 public:
-    ObjectPtr Apply(ObjectPtr obj) override;
+    ObjectPtr Apply(Context* context, const std::vector<ObjectPtr>& args) override;
 };
 
 class SetCdrFunction : public Function {
 public:
-    ObjectPtr Apply(ObjectPtr obj) override;
+    ObjectPtr Apply(Context* context, const std::vector<ObjectPtr>& args) override;
+};
+
+// Vector functions
+
+class VectorFunction : public Function {
+public:
+    ObjectPtr Apply(Context* context, const std::vector<ObjectPtr>& args) override;
+};
+
+class MakeVectorFunction : public Function {
+public:
+    ObjectPtr Apply(Context* context, const std::vector<ObjectPtr>& args) override;
+};
+
+class VectorLengthFunction : public Function {
+public:
+    ObjectPtr Apply(Context* context, const std::vector<ObjectPtr>& args) override;
+};
+
+class VectorRefFunction : public Function {
+public:
+    ObjectPtr Apply(Context* context, const std::vector<ObjectPtr>& args) override;
+};
+
+class VectorSetFunction : public Function {
+public:
+    ObjectPtr Apply(Context* context, const std::vector<ObjectPtr>& args) override;
+};
+
+class VectorFillFunction : public Function {
+public:
+    ObjectPtr Apply(Context* context, const std::vector<ObjectPtr>& args) override;
+};
+
+class VectorCopyFunction : public Function {
+public:
+    ObjectPtr Apply(Context* context, const std::vector<ObjectPtr>& args) override;
+};
+
+class VectorToListFunction : public Function {
+public:
+    ObjectPtr Apply(Context* context, const std::vector<ObjectPtr>& args) override;
+};
+
+class ListToVectorFunction : public Function {
+public:
+    ObjectPtr Apply(Context* context, const std::vector<ObjectPtr>& args) override;
 };
 
 // Number functions
 
+// Fixnums are compared directly, other integers as big integers and
+// anything involving a real as doubles.
 template <typename Comparator>
 class CompareFunction : public Function {
 public:
-    ObjectPtr Apply(ObjectPtr obj) override {
-        std::vector<ObjectPtr> args = GetArgList(obj);
-        EvaluateArgs(args);
-        if (!IsAll<Number>(args)) {
+    ObjectPtr Apply(Context*, const std::vector<ObjectPtr>& args) override {
+        if (!IsAll<RealNumber>(args)) {
             throw RuntimeError("Arguments of compare function should be numbers");
         }
         Comparator cmp;
         bool res = true;
+        bool fixnums = IsAll<Number>(args);
+        bool integers = fixnums || IsAll<Integer>(args);
         for (size_t i = 0; !args.empty() && i < args.size() - 1; ++i) {
-            res &= cmp(As<Number>(args[i])->GetValue(), As<Number>(args[i + 1])->GetValue());
+            const ObjectPtr& lhs = args[i];
+            const ObjectPtr& rhs = args[i + 1];
+            if (fixnums) {
+                res &= cmp(Cast<Number>(lhs)->GetValue(), Cast<Number>(rhs)->GetValue());
+            } else if (integers) {
+                res &= cmp(GetBigInteger(lhs), GetBigInteger(rhs));
+            } else {
+                res &= cmp(GetDouble(lhs), GetDouble(rhs));
+            }
         }
-        return (res ? std::make_shared<Symbol>("#t") : std::make_shared<Symbol>("#f"));
+        return GetBoolean(res);
+    }
+};
+
+// Checks the limits before an operation on big integers with a result of at
+// most limbs limbs. Such an operation makes no calls, but long operands make
+// it slow and its result long.
+void CheckBigIntegerOperation(Context* context, size_t limbs);
+
+// Operations of ArithmeticFunction. The fixnum overload returns false if the
+// result does not fit into int64_t; the operation is then redone on big
+// integers, whose result has at most GetResultLimbs limbs. Reals use the
+// double overload, numeric vectors the kernel.
+
+struct Add {
+    static constexpr VectorOperation kVectorOperation = VectorOperation::kAdd;
+
+    static size_t GetResultLimbs(size_t lhs, size_t rhs) {
+        return std::max(lhs, rhs) + 1;
+    }
+    static bool Apply(int64_t lhs, int64_t rhs, int64_t* res) {
+        return !__builtin_add_overflow(lhs, rhs, res);
+    }
+    static BigInteger Apply(const BigInteger& lhs, const BigInteger& rhs) {
+        return lhs + rhs;
+    }
+    static double Apply(double lhs, double rhs) {
+        return lhs + rhs;
+    }
+};
+
+struct Subtract {
+    static constexpr VectorOperation kVectorOperation = VectorOperation::kSubtract;
+
+    static size_t GetResultLimbs(size_t lhs, size_t rhs) {
+        return std::max(lhs, rhs) + 1;
+    }
+    static bool Apply(int64_t lhs, int64_t rhs, int64_t* res) {
+        return !__builtin_sub_overflow(lhs, rhs, res);
+    }
+    static BigInteger Apply(const BigInteger& lhs, const BigInteger& rhs) {
+        return lhs - rhs;
+    }
+    static double Apply(double lhs, double rhs) {
+        return lhs - rhs;
+    }
+};
+
+struct Multiply {
+    static constexpr VectorOperation kVectorOperation = VectorOperation::kMultiply;
+
+    static size_t GetResultLimbs(size_t lhs, size_t rhs) {
+        return lhs + rhs;
+    }
+    static bool Apply(int64_t lhs, int64_t rhs, int64_t* res) {
+        return !__builtin_mul_overflow(lhs, rhs, res);
+    }
+    static BigInteger Apply(const BigInteger& lhs, const BigInteger& rhs) {
+        return lhs * rhs;
+    }
+    static double Apply(double lhs, double rhs) {
+        return lhs * rhs;
+    }
+};
+
+struct Divide {
+    static constexpr VectorOperation kVectorOperation = VectorOperation::kDivide;
+
+    static size_t GetResultLimbs(size_t lhs, size_t) {
+        return lhs;
+    }
+    static bool Apply(int64_t lhs, int64_t rhs, int64_t* res) {
+        if (rhs == 0) {
+            throw RuntimeError("Division by zero");
+        }
+        if (lhs == INT64_MIN && rhs == -1) {
+            return false;
+        }
+        *res = lhs / rhs;
+        return true;
+    }
+    static BigInteger Apply(const BigInteger& lhs, const BigInteger& rhs) {
+        if (rhs.IsZero()) {
+            throw RuntimeError("Division by zero");
+        }
+        return lhs / rhs;
+    }
+    static double Apply(double lhs, double rhs) {
+        return lhs / rhs;
     }
 };
 
-template <typename T>
 struct Min {
-    T operator()(T t1, T t2) {
-        return std::min(t1, t2);
+    static constexpr VectorOperation kVectorOperation = VectorOperation::kMin;
+
+    static size_t GetResultLimbs(size_t lhs, size_t rhs) {
+        return std::max(lhs, rhs);
+    }
+    static bool Apply(int64_t lhs, int64_t rhs, int64_t* res) {
+        *res = std::min(lhs, rhs);
+        return true;
+    }
+    static BigInteger Apply(const BigInteger& lhs, const BigInteger& rhs) {
+        return std::min(lhs, rhs);
+    }
+    static double Apply(double lhs, double rhs) {
+        return lhs < rhs ? lhs : rhs;
     }
 };
 
-template <typename T>
 struct Max {
-    T operator()(T t1, T t2) {
-        return std::max(t1, t2);
+    static constexpr VectorOperation kVectorOperation = VectorOperation::kMax;
+
+    static size_t GetResultLimbs(size_t lhs, size_t rhs) {
+        return std::max(lhs, rhs);
+    }
+    static bool Apply(int64_t lhs, int64_t rhs, int64_t* res) {
+        *res = std::max(lhs, rhs);
+        return true;
+    }
+    static BigInteger Apply(const BigInteger& lhs, const BigInteger& rhs) {
+        return std::max(lhs, rhs);
+    }
+    static double Apply(double lhs, double rhs) {
+        return lhs > rhs ? lhs : rhs;
     }
 };
 
-template <typename F>
+template <typename Operation>
 class ArithmeticFunction : public Function {
 public:
     ArithmeticFunction() = default;
     explicit ArithmeticFunction(int64_t base_value) : base_value_(base_value) {
     }
 
-    ObjectPtr Apply(ObjectPtr obj) override {
-        std::vector<ObjectPtr> args = GetArgList(obj);
-        EvaluateArgs(args);
-        if (!IsAll<Number>(args)) {
-            throw RuntimeError("Arguments of arithmetic function should be numbers");
+    ObjectPtr Apply(Context* context, const std::vector<ObjectPtr>& args) override {
+        if (!IsAll<Integer>(args)) {
+            return ApplyInexact(args);
         }
         if (args.empty()) {
             if (base_value_) {
-                return std::make_shared<Number>(base_value_.value());
+                return MakeNumber(base_value_.value());
             }
             throw RuntimeError("Function expected at least 1 argument, got 0");
         }
-        F func;
-        int64_t res = As<Number>(args[0])->GetValue();
-        for (size_t i = 1; i < args.size(); ++i) {
-            res = func(res, As<Number>(args[i])->GetValue());
+        // Stay on fixnums until an operand is big or a result overflows.
+        size_t i = 1;
+        BigInteger big_res;
+        if (const Number* first = Cast<Number>(args[0])) {
+            int64_t res = first->GetValue();
+            for (int64_t next; i < args.size(); ++i) {
+                const Number* number = Cast<Number>(args[i]);
+                if (!number || !Operation::Apply(res, number->GetValue(), &next)) {
+                    break;
+                }
+                res = next;
+            }
+            if (i == args.size()) {
+                return MakeNumber(res);
+            }
+            big_res = res;
+        } else {
+            big_res = Cast<BigNumber>(args[0])->GetValue();
         }
-        return std::make_shared<Number>(res);
+        for (; i < args.size(); ++i) {
+            BigInteger operand = GetBigInteger(args[i]);
+            // Constant folding calls builtins without a context.
+            if (context) {
+                CheckBigIntegerOperation(
+                    context,
+                    Operation::GetResultLimbs(big_res.GetLimbCount(), operand.GetLimbCount()));
+            }
+            big_res = Operation::Apply(big_res, operand);
+        }
+        return MakeInteger(std::move(big_res));
     }
 
 private:
+    // Reals and numeric vectors make the result inexact. Vectors combine
+    // elementwise, numbers are broadcast over them.
+    static ObjectPtr ApplyInexact(const std::vector<ObjectPtr>& args) {
+        for (const auto& arg : args) {
+            if (!Is<RealNumber>(arg) && !Is<NumericVector>(arg)) {
+                throw RuntimeError("Arguments of arithmetic function should be numbers");
+            }
+        }
+        constexpr VectorOperation kVector = Operation::kVectorOperation;
+        bool is_vector = false;
+        std::vector<double> values;
+        double res = 0;
+        if (const NumericVector* first = Cast<NumericVector>(args[0])) {
+            values = first->GetValues();
+            is_vector = true;
+        } else {
+            res = GetDouble(args[0]);
+        }
+        for (size_t i = 1; i < args.size(); ++i) {
+            const NumericVector* vector = Cast<NumericVector>(args[i]);
+            if (!vector) {
+                double operand = GetDouble(args[i]);
+                if (is_vector) {
+                    ApplyVectorOperation(kVector, values, {&operand, 1}, values);
+                } else {
+                    res = Operation::Apply(res, operand);
+                }
+            } else if (!is_vector) {
+                const std::vector<double>& operand = vector->GetValues();
+                values.resize(operand.size());
+                ApplyVectorOperation(kVector, {&res, 1}, operand, values);
+                is_vector = true;
+            } else {
+                if (vector->GetValues().size() != values.size()) {
+                    throw RuntimeError("Vectors of arithmetic function should have equal lengths");
+                }
+                ApplyVectorOperation(kVector, values, vector->GetValues(), values);
+            }
+        }
+        if (is_vector) {
+            return MakeObject<NumericVector>(std::move(values));
+        }
+        return MakeObject<Real>(res);
+    }
+
     std::optional<int64_t> base_value_;
 };
 
 class AbsFunction : public Function {
 public:
-    ObjectPtr Apply(ObjectPtr obj) override;
+    ObjectPtr Apply(Context* context, const std::vector<ObjectPtr>& args) override;
 };
 
-// boolean functions
+// Numeric vector functions
+
+bool IsNumericVector(ObjectPtr obj);
 
-template <typename F>
-class BooleanFunction : public Function {
+class NumericVectorFunction : public Function {
 public:
-    BooleanFunction(bool base_value, bool return_value)
-        : base_value_(base_value), return_value_(return_value) {
-    }
+    ObjectPtr Apply(Context* context, const std::vector<ObjectPtr>& args) override;
+};
 
-    ObjectPtr Apply(ObjectPtr obj) override {
-        std::vector<ObjectPtr> args = GetArgList(obj);
-        if (args.empty()) {
-            return GetBoolean(base_value_);
-        }
-        F func;
-        bool res = base_value_;
-        for (size_t i = 0; i < args.size(); ++i) {
-            args[i] = args[i]->Evaluate();
-            res = func(res, !IsFalse(args[i]));
-            if (res == return_value_) {
-                return args[i];
-            }
-        }
-        return args.back();
-    }
+class MakeNumericVectorFunction : public Function {
+public:
+    ObjectPtr Apply(Context* context, const std::vector<ObjectPtr>& args) override;
+};
 
-private:
-    bool base_value_, return_value_;
+class NumericVectorLengthFunction : public Function {
+public:
+    ObjectPtr Apply(Context* context, const std::vector<ObjectPtr>& args) override;
+};
+
+class NumericVectorRefFunction : public Function {
+public:
+    ObjectPtr Apply(Context* context, const std::vector<ObjectPtr>& args) override;
+};
+
+class NumericVectorSetFunction : public Function {
+public:
+    ObjectPtr Apply(Context* context, const std::vector<ObjectPtr>& args) override;
+};
+
+class NumericVectorSumFunction : public Function {
+public:
+    ObjectPtr Apply(Context* context, const std::vector<ObjectPtr>& args) override;
 };
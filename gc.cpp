@@ -0,0 +1,209 @@
+#include "gc.h"
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+static constexpr size_t kThresholds[GarbageCollector::kGenerations] = {10000, 10, 10};
+
+// Default collector for objects created outside of any interpreter. Never
+// destroyed: tracked objects may outlive thread-local destructors.
+static thread_local GarbageCollector* current_collector = nullptr;
+
+static GarbageCollector* GetDefaultCollector() {
+    static thread_local GarbageCollector* collector = new GarbageCollector();
+    return collector;
+}
+
+GarbageCollector* GarbageCollector::SetCurrent(GarbageCollector* collector) {
+    GarbageCollector* previous = current_collector;
+    current_collector = collector;
+    return previous;
+}
+
+GarbageCollector* GarbageCollector::GetCurrent() {
+    return current_collector ? current_collector : GetDefaultCollector();
+}
+
+void GarbageCollector::Track(Collectable* obj) {
+    std::unique_lock lock(mutex_, std::defer_lock);
+    if (shared_.load(std::memory_order_relaxed)) {
+        lock.lock();
+    }
+    obj->owner_ = this;
+    obj->generation_ = 0;
+    Link(obj);
+    ++counts_[0];
+    ++size_;
+}
+
+void GarbageCollector::Untrack(Collectable* obj) {
+    std::unique_lock lock(mutex_, std::defer_lock);
+    if (shared_.load(std::memory_order_relaxed)) {
+        lock.lock();
+    }
+    Unlink(obj);
+    --size_;
+    if (released_ && size_ == 0) {
+        if (lock.owns_lock()) {
+            lock.unlock();
+        }
+        delete this;
+    }
+}
+
+void GarbageCollector::Release() {
+    std::unique_lock lock(mutex_);
+    released_ = true;
+    if (size_ == 0) {
+        lock.unlock();
+        delete this;
+    }
+}
+
+void GarbageCollector::Share() {
+    shared_.store(true, std::memory_order_relaxed);
+}
+
+void GarbageCollector::MaybeCollect() {
+    if (counts_[0] <= kThresholds[0] || collecting_) {
+        return;
+    }
+    for (int generation = kGenerations - 1; generation >= 0; --generation) {
+        if (counts_[generation] > kThresholds[generation]) {
+            Collect(generation);
+            return;
+        }
+    }
+}
+
+size_t GarbageCollector::Collect(int generation) {
+    if (collecting_) {
+        return 0;
+    }
+    collecting_ = true;
+    generation = std::clamp(generation, 0, kGenerations - 1);
+    for (int younger = 0; younger < generation; ++younger) {
+        while (heads_[younger]) {
+            Move(heads_[younger], generation);
+        }
+    }
+
+    std::vector<Collectable*> objects;
+    for (Collectable* obj = heads_[generation]; obj; obj = obj->next_) {
+        objects.push_back(obj);
+    }
+
+    // Count the references coming from outside the collected generation.
+    for (Collectable* obj : objects) {
+        obj->gc_refs_ = obj->UseCount();
+        // Objects not owned by a shared_ptr yet are still being built.
+        if (obj->gc_refs_ == 0) {
+            obj->gc_refs_ = std::numeric_limits<long>::max();
+        }
+        obj->reachable_ = false;
+    }
+    for (Collectable* obj : objects) {
+        obj->Traverse([this, generation](Collectable* child) {
+            if (child->owner_ == this && child->generation_ == generation) {
+                --child->gc_refs_;
+            }
+        });
+    }
+
+    // Mark everything reachable from externally referenced objects.
+    std::vector<Collectable*> stack;
+    for (Collectable* obj : objects) {
+        if (obj->gc_refs_ > 0) {
+            obj->reachable_ = true;
+            stack.push_back(obj);
+        }
+    }
+    while (!stack.empty()) {
+        Collectable* obj = stack.back();
+        stack.pop_back();
+        obj->Traverse([this, generation, &stack](Collectable* child) {
+            if (child->owner_ == this && child->generation_ == generation &&
+                !child->reachable_) {
+                child->reachable_ = true;
+                stack.push_back(child);
+            }
+        });
+    }
+
+    // Survivors move to the next generation. Garbage is held while its
+    // references are cleared, so nothing is freed in the middle of it.
+    std::vector<Collectable*> garbage;
+    std::vector<std::shared_ptr<void>> holds;
+    int older = std::min(generation + 1, kGenerations - 1);
+    for (Collectable* obj : objects) {
+        if (obj->reachable_) {
+            Move(obj, older);
+        } else {
+            garbage.push_back(obj);
+            holds.push_back(obj->Hold());
+        }
+    }
+    for (Collectable* obj : garbage) {
+        obj->Clear();
+    }
+    // Keep this collector alive even if it was released and the garbage was
+    // all it had left.
+    ++size_;
+    holds.clear();
+    --size_;
+
+    if (generation + 1 < kGenerations) {
+        ++counts_[generation + 1];
+    }
+    for (int younger = 0; younger <= generation; ++younger) {
+        counts_[younger] = 0;
+    }
+    collecting_ = false;
+    size_t freed = garbage.size();
+    if (released_ && size_ == 0) {
+        delete this;
+    }
+    return freed;
+}
+
+void GarbageCollector::Link(Collectable* obj) {
+    obj->prev_ = nullptr;
+    obj->next_ = heads_[obj->generation_];
+    if (obj->next_) {
+        obj->next_->prev_ = obj;
+    }
+    heads_[obj->generation_] = obj;
+}
+
+void GarbageCollector::Unlink(Collectable* obj) {
+    if (obj->prev_) {
+        obj->prev_->next_ = obj->next_;
+    } else {
+        heads_[obj->generation_] = obj->next_;
+    }
+    if (obj->next_) {
+        obj->next_->prev_ = obj->prev_;
+    }
+}
+
+void GarbageCollector::Move(Collectable* obj, int generation) {
+    Unlink(obj);
+    obj->generation_ = generation;
+    Link(obj);
+}
+
+Collectable::Collectable() {
+    GarbageCollector::GetCurrent()->Track(this);
+}
+
+Collectable::~Collectable() {
+    owner_->Untrack(this);
+}
+
+size_t CollectGarbage(int generation) {
+    return GarbageCollector::GetCurrent()->Collect(generation);
+}
+
+void MaybeCollectGarbage() {
+    GarbageCollector::GetCurrent()->MaybeCollect();
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+// Objects that hold references to other objects and so may take part in a
+// reference cycle (a lambda capturing the frame it is stored in, lists
+// closed with set-cdr!). Reference counting frees everything else; these
+// are additionally tracked by the cycle collector.
+//
+// The collector is a generational mark-and-sweep over tracked objects. An
+// object is a root if it has more strong references than the tracked heap
+// itself accounts for, i.e. something outside (the C++ stack, the global
+// scope, the VM stack, compiled code) refers to it. Whatever is not reachable
+// from the roots is garbage held alive only by cycles; the collector clears
+// its references and lets reference counting free it.
+
+class GarbageCollector;
+
+class Collectable {
+public:
+    // Registers with the current collector of this thread.
+    Collectable();
+    virtual ~Collectable();
+
+    Collectable(const Collectable&) = delete;
+    Collectable& operator=(const Collectable&) = delete;
+
+    // Calls visit for every collectable object this one references.
+    virtual void Traverse(const std::function<void(Collectable*)>& visit) = 0;
+    // Drops all references held by this object.
+    virtual void Clear() = 0;
+    // Number of strong references to this object.
+    virtual long UseCount() const = 0;
+    // Strong reference that keeps this object alive.
+    virtual std::shared_ptr<void> Hold() = 0;
+
+private:
+    friend class GarbageCollector;
+
+    GarbageCollector* owner_;
+    Collectable* prev_;
+    Collectable* next_;
+    int generation_;
+    long gc_refs_;
+    bool reachable_;
+};
+
+// Every interpreter has its own collector, which is made current on the
+// thread running it; objects created outside of any interpreter go to a
+// per-thread default collector. A collector is used by one thread at a time
+// unless Share was called; then objects may be created and destroyed from
+// several threads, but collections must only run while no other thread uses
+// its objects.
+class GarbageCollector {
+public:
+    static constexpr int kGenerations = 3;
+
+    // Returns the previous current collector of this thread.
+    static GarbageCollector* SetCurrent(GarbageCollector* collector);
+    static GarbageCollector* GetCurrent();
+
+    // Collects generations up to and including the given one; returns the
+    // number of freed objects.
+    size_t Collect(int generation);
+
+    // Collects the young generations when enough tracked objects were created
+    // since the last collection. Must not be called while an object is being
+    // constructed.
+    void MaybeCollect();
+
+    // Called by the owner instead of delete: the collector frees itself once
+    // its last tracked object is gone.
+    void Release();
+
+    // Makes tracking thread-safe from now on. Must be called by the thread
+    // using the collector before objects are handed to other threads.
+    void Share();
+
+private:
+    friend class Collectable;
+
+    void Track(Collectable* obj);
+    void Untrack(Collectable* obj);
+
+    void Link(Collectable* obj);
+    void Unlink(Collectable* obj);
+    void Move(Collectable* obj, int generation);
+
+    Collectable* heads_[kGenerations] = {};
+    size_t counts_[kGenerations] = {};
+    size_t size_ = 0;
+    bool collecting_ = false;
+    bool released_ = false;
+    std::atomic<bool> shared_ = false;
+    std::mutex mutex_;
+};
+
+// Shortcuts for the current collector of this thread.
+size_t CollectGarbage(int generation = GarbageCollector::kGenerations - 1);
+void MaybeCollectGarbage();
@@ -0,0 +1,367 @@
+#include "hash_table.h"
+#include "analyzer.h"
+#include "context.h"
+#include "error.h"
+#include "functions.h"
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <string_view>
+#include <unordered_set>
+#include <utility>
+
+namespace {
+
+// Lists and vectors are hashed by their first objects only: long keys stay
+// cheap to hash, and equal keys still get equal hashes.
+constexpr size_t kMaxHashedObjects = 32;
+constexpr size_t kMinCapacity = 8;
+// Comparing keys counts a step every this many pairs of objects. Pairs are
+// remembered once that many were compared, in case the keys are cyclic.
+constexpr size_t kComparedPairsPerStep = 256;
+
+// Finalizer of splitmix64: the slot is picked by the low bits of the hash,
+// so every bit of the input has to reach them.
+uint64_t Mix(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111eb;
+    x ^= x >> 31;
+    return x;
+}
+
+struct PairHash {
+    size_t operator()(const std::pair<Object*, Object*>& pair) const {
+        return Mix(reinterpret_cast<uintptr_t>(pair.first) ^
+                   Mix(reinterpret_cast<uintptr_t>(pair.second)));
+    }
+};
+
+// Hash of obj itself, without its elements.
+uint64_t HashObject(const Object* obj) {
+    if (!obj) {
+        return 0;
+    }
+    switch (obj->GetType()) {
+        case ObjectType::kNumber:
+            return static_cast<const Number*>(obj)->GetValue();
+        case ObjectType::kBigNumber:
+            return static_cast<const BigNumber*>(obj)->GetValue().Hash();
+        case ObjectType::kReal:
+            return std::bit_cast<uint64_t>(static_cast<const Real*>(obj)->GetValue());
+        case ObjectType::kCell:
+        case ObjectType::kVector:
+            return static_cast<uint64_t>(obj->GetType());
+        default:
+            return reinterpret_cast<uintptr_t>(obj);
+    }
+}
+
+HashTable* GetHashTable(const ObjectPtr& obj, std::string_view function) {
+    HashTable* table = Cast<HashTable>(obj);
+    if (!table) {
+        throw RuntimeError("First argument of " + std::string(function) + " should be hash table");
+    }
+    return table;
+}
+
+}  // namespace
+
+size_t HashKey(const ObjectPtr& key) {
+    uint64_t hash = 0;
+    std::vector<Object*> pending = {key.get()};
+    for (size_t visited = 0; !pending.empty() && visited < kMaxHashedObjects; ++visited) {
+        Object* obj = pending.back();
+        pending.pop_back();
+        hash = Mix(hash ^ HashObject(obj));
+        if (!obj) {
+            continue;
+        }
+        if (obj->GetType() == ObjectType::kCell) {
+            Cell* cell = static_cast<Cell*>(obj);
+            pending.push_back(cell->GetSecond().get());
+            pending.push_back(cell->GetFirst().get());
+        } else if (obj->GetType() == ObjectType::kVector) {
+            const std::vector<ObjectPtr>& elements = static_cast<Vector*>(obj)->GetElements();
+            for (size_t i = elements.size(); i-- > 0;) {
+                pending.push_back(elements[i].get());
+            }
+        }
+    }
+    return hash;
+}
+
+bool KeysEqual(const ObjectPtr& lhs, const ObjectPtr& rhs, Context* context) {
+    std::vector<std::pair<Object*, Object*>> pending = {{lhs.get(), rhs.get()}};
+    std::unordered_set<std::pair<Object*, Object*>, PairHash> compared;
+    for (size_t count = 1; !pending.empty(); ++count) {
+        if (count % kComparedPairsPerStep == 0 && context) {
+            context->CountStep();
+        }
+        std::pair<Object*, Object*> pair = pending.back();
+        pending.pop_back();
+        auto [a, b] = pair;
+        if (a == b) {
+            continue;
+        }
+        if (!a || !b || a->GetType() != b->GetType()) {
+            return false;
+        }
+        // A pair met again is part of a cycle. It is equal unless some other
+        // pair differs, so it need not be compared twice.
+        bool is_compound =
+            (a->GetType() == ObjectType::kCell || a->GetType() == ObjectType::kVector);
+        if (count >= kComparedPairsPerStep && is_compound && !compared.insert(pair).second) {
+            continue;
+        }
+        switch (a->GetType()) {
+            case ObjectType::kNumber:
+                if (static_cast<Number*>(a)->GetValue() != static_cast<Number*>(b)->GetValue()) {
+                    return false;
+                }
+                break;
+            case ObjectType::kBigNumber:
+                if (static_cast<BigNumber*>(a)->GetValue() !=
+                    static_cast<BigNumber*>(b)->GetValue()) {
+                    return false;
+                }
+                break;
+            case ObjectType::kReal:
+                // Compared as eqv? does: 0.0 and -0.0 differ, NaN equals itself.
+                if (std::bit_cast<uint64_t>(static_cast<Real*>(a)->GetValue()) !=
+                    std::bit_cast<uint64_t>(static_cast<Real*>(b)->GetValue())) {
+                    return false;
+                }
+                break;
+            case ObjectType::kCell: {
+                Cell* x = static_cast<Cell*>(a);
+                Cell* y = static_cast<Cell*>(b);
+                pending.emplace_back(x->GetSecond().get(), y->GetSecond().get());
+                pending.emplace_back(x->GetFirst().get(), y->GetFirst().get());
+                break;
+            }
+            case ObjectType::kVector: {
+                const std::vector<ObjectPtr>& x = static_cast<Vector*>(a)->GetElements();
+                const std::vector<ObjectPtr>& y = static_cast<Vector*>(b)->GetElements();
+                if (x.size() != y.size()) {
+                    return false;
+                }
+                for (size_t i = x.size(); i-- > 0;) {
+                    pending.emplace_back(x[i].get(), y[i].get());
+                }
+                break;
+            }
+            default:
+                return false;
+        }
+    }
+    return true;
+}
+
+// HashTable
+
+std::string HashTable::ToString() const {
+    return "#<hash-table>";
+}
+
+size_t HashTable::FindSlot(const ObjectPtr& key, size_t hash, Context* context) const {
+    size_t mask = slots_.size() - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+        const Slot& slot = slots_[i];
+        if (!slot.used || (slot.hash == hash && KeysEqual(slot.key, key, context))) {
+            return i;
+        }
+    }
+}
+
+ObjectPtr* HashTable::Find(const ObjectPtr& key, Context* context) {
+    if (size_ == 0) {
+        return nullptr;
+    }
+    Slot& slot = slots_[FindSlot(key, HashKey(key), context)];
+    return slot.used ? &slot.value : nullptr;
+}
+
+void HashTable::Set(const ObjectPtr& key, ObjectPtr value, Context* context) {
+    // At most three quarters full, so clusters stay short.
+    if ((size_ + 1) * 4 > slots_.size() * 3) {
+        Grow();
+    }
+    size_t hash = HashKey(key);
+    Slot& slot = slots_[FindSlot(key, hash, context)];
+    if (!slot.used) {
+        slot.key = key;
+        slot.hash = hash;
+        slot.used = true;
+        ++size_;
+    }
+    slot.value = std::move(value);
+}
+
+bool HashTable::Erase(const ObjectPtr& key, Context* context) {
+    if (size_ == 0) {
+        return false;
+    }
+    size_t mask = slots_.size() - 1;
+    size_t hole = FindSlot(key, HashKey(key), context);
+    if (!slots_[hole].used) {
+        return false;
+    }
+    // An entry may fill the hole if the hole lies between its home slot and
+    // the slot it is in now.
+    for (size_t i = (hole + 1) & mask; slots_[i].used; i = (i + 1) & mask) {
+        size_t home = slots_[i].hash & mask;
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            slots_[hole] = std::move(slots_[i]);
+            hole = i;
+        }
+    }
+    slots_[hole] = Slot();
+    --size_;
+    return true;
+}
+
+size_t HashTable::GetSize() const {
+    return size_;
+}
+
+void HashTable::Grow() {
+    std::vector<Slot> old = std::move(slots_);
+    slots_ = std::vector<Slot>(std::max(kMinCapacity, old.size() * 2));
+    owned_memory_.Set(slots_.capacity() * sizeof(Slot));
+    size_t mask = slots_.size() - 1;
+    for (Slot& slot : old) {
+        if (!slot.used) {
+            continue;
+        }
+        size_t i = slot.hash & mask;
+        while (slots_[i].used) {
+            i = (i + 1) & mask;
+        }
+        slots_[i] = std::move(slot);
+    }
+}
+
+void HashTable::ForEach(
+    const std::function<void(const ObjectPtr&, const ObjectPtr&)>& visit) const {
+    for (const Slot& slot : slots_) {
+        if (slot.used) {
+            visit(slot.key, slot.value);
+        }
+    }
+}
+
+void HashTable::Traverse(const std::function<void(Collectable*)>& visit) {
+    for (const Slot& slot : slots_) {
+        VisitCollectable(slot.key, visit);
+        VisitCollectable(slot.value, visit);
+    }
+}
+
+void HashTable::Clear() {
+    slots_.clear();
+    size_ = 0;
+}
+
+long HashTable::UseCount() const {
+    return weak_from_this().use_count();
+}
+
+std::shared_ptr<void> HashTable::Hold() {
+    return shared_from_this();
+}
+
+// Functions
+
+bool IsHashTable(ObjectPtr obj) {
+    return Is<HashTable>(obj);
+}
+
+ObjectPtr MakeHashTableFunction::Apply(Context*, const std::vector<ObjectPtr>& args) {
+    CheckArgumentsCount<RuntimeError>(args, 0, 0);
+    return MakeObject<HashTable>();
+}
+
+ObjectPtr HashTableRefFunction::Apply(Context* context, const std::vector<ObjectPtr>& args) {
+    CheckArgumentsCount<RuntimeError>(args, 2, 3);
+    if (args.size() == 3 && !Is<Function>(args[2])) {
+        throw RuntimeError("Third argument of hash-table-ref should be a function");
+    }
+    if (ObjectPtr* value = GetHashTable(args[0], "hash-table-ref")->Find(args[1], context)) {
+        return *value;
+    }
+    if (args.size() == 2) {
+        throw RuntimeError("Key is not in hash table");
+    }
+    return ApplyFunction(context, args[2], {});
+}
+
+ObjectPtr HashTableRefDefaultFunction::Apply(Context* context,
+                                             const std::vector<ObjectPtr>& args) {
+    CheckArgumentsCount<RuntimeError>(args, 3, 3);
+    ObjectPtr* value = GetHashTable(args[0], "hash-table-ref/default")->Find(args[1], context);
+    return value ? *value : args[2];
+}
+
+ObjectPtr HashTableSetFunction::Apply(Context* context, const std::vector<ObjectPtr>& args) {
+    CheckArgumentsCount<RuntimeError>(args, 3, 3);
+    GetHashTable(args[0], "hash-table-set!")->Set(args[1], args[2], context);
+    return nullptr;
+}
+
+ObjectPtr HashTableDeleteFunction::Apply(Context* context, const std::vector<ObjectPtr>& args) {
+    CheckArgumentsCount<RuntimeError>(args, 2, 2);
+    GetHashTable(args[0], "hash-table-delete!")->Erase(args[1], context);
+    return nullptr;
+}
+
+ObjectPtr HashTableContainsFunction::Apply(Context* context,
+                                           const std::vector<ObjectPtr>& args) {
+    CheckArgumentsCount<RuntimeError>(args, 2, 2);
+    HashTable* table = GetHashTable(args[0], "hash-table-contains?");
+    return GetBoolean(table->Find(args[1], context) != nullptr);
+}
+
+ObjectPtr HashTableCountFunction::Apply(Context*, const std::vector<ObjectPtr>& args) {
+    CheckArgumentsCount<RuntimeError>(args, 1, 1);
+    return MakeNumber(GetHashTable(args[0], "hash-table-count")->GetSize());
+}
+
+ObjectPtr HashTableListFunction::Apply(Context*, const std::vector<ObjectPtr>& args) {
+    CheckArgumentsCount<RuntimeError>(args, 1, 1);
+    const HashTable* table = GetHashTable(args[0], GetName());
+    std::vector<ObjectPtr> items;
+    items.reserve(table->GetSize());
+    table->ForEach([this, &items](const ObjectPtr& key, const ObjectPtr& value) {
+        switch (part_) {
+            case kKeys:
+                items.push_back(key);
+                break;
+            case kValues:
+                items.push_back(value);
+                break;
+            case kEntries:
+                items.push_back(MakeObject<Cell>(key, value));
+                break;
+        }
+    });
+    return GetListFromArgs(items);
+}
+
+ObjectPtr HashTableWalkFunction::Apply(Context* context, const std::vector<ObjectPtr>& args) {
+    CheckArgumentsCount<RuntimeError>(args, 2, 2);
+    const HashTable* table = GetHashTable(args[0], "hash-table-walk");
+    if (!Is<Function>(args[1])) {
+        throw RuntimeError("Second argument of hash-table-walk should be a function");
+    }
+    std::vector<std::pair<ObjectPtr, ObjectPtr>> entries;
+    entries.reserve(table->GetSize());
+    table->ForEach([&entries](const ObjectPtr& key, const ObjectPtr& value) {
+        entries.emplace_back(key, value);
+    });
+    for (auto& [key, value] : entries) {
+        ApplyFunction(context, args[1], {key, value});
+    }
+    return nullptr;
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+#include "object.h"
+
+// Keys of hash tables are compared like equal?: numbers by value and
+// exactness, lists and vectors by structure, everything else by identity
+// (symbols are interned, so that is by name). Cyclic keys are equal if
+// unfolding them gives the same infinite structure. A key mutated while in a
+// table may not be found again.
+size_t HashKey(const ObjectPtr& key);
+// Long comparisons count steps of context, if given, so that evaluation
+// limits apply to them.
+bool KeysEqual(const ObjectPtr& lhs, const ObjectPtr& rhs, Context* context = nullptr);
+
+// Open-addressing hash table with linear probing over a power-of-two array
+// of slots. Deleting an entry shifts the rest of its cluster back instead of
+// leaving a tombstone, so a lookup stops at the first empty slot. Not
+// synchronized: a table must not be modified by tasks running in parallel.
+class HashTable : public Object, public Collectable {
+public:
+    HashTable() : Object(ObjectType::kHashTable) {
+    }
+    static bool IsInstance(ObjectType type) {
+        return type == ObjectType::kHashTable;
+    }
+
+    std::string ToString() const override;
+
+    // Value stored under key, or null if there is none. Valid until the table
+    // is modified.
+    // Keys are compared with the steps counted by context.
+    ObjectPtr* Find(const ObjectPtr& key, Context* context);
+    void Set(const ObjectPtr& key, ObjectPtr value, Context* context);
+    // Returns whether there was an entry to remove.
+    bool Erase(const ObjectPtr& key, Context* context);
+    size_t GetSize() const;
+
+    // Calls visit for every entry, in unspecified order. visit must not
+    // modify the table.
+    void ForEach(const std::function<void(const ObjectPtr&, const ObjectPtr&)>& visit) const;
+
+    void Traverse(const std::function<void(Collectable*)>& visit) override;
+    void Clear() override;
+    long UseCount() const override;
+    std::shared_ptr<void> Hold() override;
+
+private:
+    struct Slot {
+        ObjectPtr key;
+        ObjectPtr value;
+        size_t hash = 0;
+        bool used = false;
+    };
+
+    // Index of the slot holding key, or of the empty slot where it belongs.
+    size_t FindSlot(const ObjectPtr& key, size_t hash, Context* context) const;
+    void Grow();
+
+    std::vector<Slot> slots_;
+    size_t size_ = 0;
+    OwnedMemory owned_memory_;
+};
+
+bool IsHashTable(ObjectPtr obj);
+
+// (make-hash-table) creates an empty table.
+class MakeHashTableFunction : public Function {
+public:
+    ObjectPtr Apply(Context* context, const std::vector<ObjectPtr>& args) override;
+};
+
+// (hash-table-ref table key [thunk]) gives the value under key; if there is
+// none, the value of (thunk), or an error without a thunk.
+class HashTableRefFunction : public Function {
+public:
+    ObjectPtr Apply(Context* context, const std::vector<ObjectPtr>& args) override;
+};
+
+// (hash-table-ref/default table key default)
+class HashTableRefDefaultFunction : public Function {
+public:
+    ObjectPtr Apply(Context* context, const std::vector<ObjectPtr>& args) override;
+};
+
+// (hash-table-set! table key value)
+class HashTableSetFunction : public Function {
+public:
+    ObjectPtr Apply(Context* context, const std::vector<ObjectPtr>& args) override;
+};
+
+// (hash-table-delete! table key)
+class HashTableDeleteFunction : public Function {
+public:
+    ObjectPtr Apply(Context* context, const std::vector<ObjectPtr>& args) override;
+};
+
+// (hash-table-contains? table key)
+class HashTableContainsFunction : public Function {
+public:
+    ObjectPtr Apply(Context* context, const std::vector<ObjectPtr>& args) override;
+};
+
+// (hash-table-count table) gives the number of entries.
+class HashTableCountFunction : public Function {
+public:
+    ObjectPtr Apply(Context* context, const std::vector<ObjectPtr>& args) override;
+};
+
+// Lists the keys, the values or the (key . value) pairs of a table.
+class HashTableListFunction : public Function {
+public:
+    enum Part { kKeys, kValues, kEntries };
+
+    explicit HashTableListFunction(Part part) : part_(part) {
+    }
+
+    ObjectPtr Apply(Context* context, const std::vector<ObjectPtr>& args) override;
+
+private:
+    Part part_;
+};
+
+// (hash-table-walk table procedure) calls (procedure key value) for every
+// entry. The entries are listed first, so procedure may modify the table.
+class HashTableWalkFunction : public Function {
+public:
+    ObjectPtr Apply(Context* context, const std::vector<ObjectPtr>& args) override;
+};
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Counters of the result cache of a memoized function.
+struct MemoStats {
+    // Calls answered from the cache.
+    uint64_t hits = 0;
+    // Calls that ran the wrapped function.
+    uint64_t misses = 0;
+    // Results dropped to make room for newer ones.
+    uint64_t evictions = 0;
+    // Results cached now, at most capacity.
+    size_t size = 0;
+    size_t capacity = 0;
+};
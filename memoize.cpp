@@ -0,0 +1,128 @@
+#include "memoize.h"
+#include "analyzer.h"
+#include "error.h"
+#include "functions.h"
+#include <string>
+
+MemoizedFunction::MemoizedFunction(ObjectPtr function, size_t capacity)
+    : Function(ObjectType::kMemoizedFunction),
+      function_(std::move(function)),
+      capacity_(capacity),
+      name_("memoized:" + std::string(Cast<Function>(function_)->GetName())) {
+}
+
+bool MemoizedFunction::KeyEqual::operator()(const ArgumentsKey& lhs,
+                                            const ArgumentsKey& rhs) const {
+    if (lhs.args->size() != rhs.args->size()) {
+        return false;
+    }
+    Context* context = (lhs.context ? lhs.context : rhs.context);
+    for (size_t i = 0; i < lhs.args->size(); ++i) {
+        if (!KeysEqual((*lhs.args)[i], (*rhs.args)[i], context)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+size_t MemoizedFunction::HashArguments(const std::vector<ObjectPtr>& args) {
+    size_t hash = args.size();
+    for (const ObjectPtr& arg : args) {
+        hash = (hash ^ HashKey(arg)) * 0x100000001b3;
+    }
+    return hash;
+}
+
+ObjectPtr MemoizedFunction::Apply(Context* context, const std::vector<ObjectPtr>& args) {
+    ArgumentsKey key{&args, HashArguments(args), context};
+    {
+        std::lock_guard lock(mutex_);
+        if (auto it = index_.find(key); it != index_.end()) {
+            ++hits_;
+            entries_.splice(entries_.begin(), entries_, it->second);
+            return it->second->value;
+        }
+        ++misses_;
+    }
+    ObjectPtr value = ApplyFunction(context, function_, args);
+    std::lock_guard lock(mutex_);
+    // A parallel task may have stored the same result meanwhile.
+    if (index_.contains(key)) {
+        return value;
+    }
+    entries_.push_front(Entry{args, key.hash, value});
+    index_.emplace(ArgumentsKey{&entries_.front().args, key.hash}, entries_.begin());
+    if (entries_.size() > capacity_) {
+        const Entry& oldest = entries_.back();
+        index_.erase(ArgumentsKey{&oldest.args, oldest.hash});
+        entries_.pop_back();
+        ++evictions_;
+    }
+    return value;
+}
+
+std::string_view MemoizedFunction::GetName() const {
+    return name_;
+}
+
+MemoStats MemoizedFunction::GetStats() const {
+    std::lock_guard lock(mutex_);
+    return MemoStats{hits_, misses_, evictions_, entries_.size(), capacity_};
+}
+
+void MemoizedFunction::Traverse(const std::function<void(Collectable*)>& visit) {
+    VisitCollectable(function_, visit);
+    for (const Entry& entry : entries_) {
+        for (const ObjectPtr& arg : entry.args) {
+            VisitCollectable(arg, visit);
+        }
+        VisitCollectable(entry.value, visit);
+    }
+}
+
+void MemoizedFunction::Clear() {
+    function_.reset();
+    index_.clear();
+    entries_.clear();
+}
+
+long MemoizedFunction::UseCount() const {
+    return weak_from_this().use_count();
+}
+
+std::shared_ptr<void> MemoizedFunction::Hold() {
+    return shared_from_this();
+}
+
+// Functions
+
+ObjectPtr MemoizeFunction::Apply(Context*, const std::vector<ObjectPtr>& args) {
+    CheckArgumentsCount<RuntimeError>(args, 1, 2);
+    if (!Is<Function>(args[0])) {
+        throw RuntimeError("First argument of memoize should be a function");
+    }
+    size_t capacity = kDefaultMemoCapacity;
+    if (args.size() == 2) {
+        const Number* number = Cast<Number>(args[1]);
+        if (!number || number->GetValue() <= 0) {
+            throw RuntimeError("Capacity of memoize should be a positive number");
+        }
+        capacity = number->GetValue();
+    }
+    return MakeObject<MemoizedFunction>(args[0], capacity);
+}
+
+ObjectPtr MemoStatsFunction::Apply(Context*, const std::vector<ObjectPtr>& args) {
+    CheckArgumentsCount<RuntimeError>(args, 1, 1);
+    const MemoizedFunction* function = Cast<MemoizedFunction>(args[0]);
+    if (!function) {
+        throw RuntimeError("Argument of memoize-stats should be a memoized function");
+    }
+    MemoStats stats = function->GetStats();
+    auto entry = [](const char* name, uint64_t value) {
+        return MakeObject<Cell>(Intern(name), MakeNumber(value));
+    };
+    return GetListFromArgs({entry("hits", stats.hits), entry("misses", stats.misses),
+                            entry("evictions", stats.evictions), entry("size", stats.size),
+                            entry("capacity", stats.capacity)});
+}
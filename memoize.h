@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "object.h"
+#include "hash_table.h"
+#include "memo_stats.h"
+
+// Function that caches the results of another one, keyed on its arguments
+// compared like hash table keys. Once the cache holds capacity results, the
+// least recently used one is evicted. Only meant for pure functions: the
+// arguments are kept as the key, so mutating one after the call makes its
+// entry stale.
+//
+// The lock is not held while the wrapped function runs, so recursive calls
+// go through the cache as well, and tasks running in parallel may compute
+// the same result twice.
+class MemoizedFunction : public Function, public Collectable {
+public:
+    MemoizedFunction(ObjectPtr function, size_t capacity);
+
+    static bool IsInstance(ObjectType type) {
+        return type == ObjectType::kMemoizedFunction;
+    }
+
+    ObjectPtr Apply(Context* context, const std::vector<ObjectPtr>& args) override;
+    std::string_view GetName() const override;
+
+    MemoStats GetStats() const;
+
+    void Traverse(const std::function<void(Collectable*)>& visit) override;
+    void Clear() override;
+    long UseCount() const override;
+    std::shared_ptr<void> Hold() override;
+
+private:
+    struct Entry {
+        std::vector<ObjectPtr> args;
+        size_t hash;
+        ObjectPtr value;
+    };
+
+    // Arguments owned by an entry, or by the caller during a lookup, so that
+    // lookups need not copy them. A lookup also gives the caller's context,
+    // which counts the steps of comparing keys.
+    struct ArgumentsKey {
+        const std::vector<ObjectPtr>* args;
+        size_t hash;
+        Context* context = nullptr;
+    };
+
+    struct KeyHash {
+        size_t operator()(const ArgumentsKey& key) const {
+            return key.hash;
+        }
+    };
+
+    struct KeyEqual {
+        bool operator()(const ArgumentsKey& lhs, const ArgumentsKey& rhs) const;
+    };
+
+    static size_t HashArguments(const std::vector<ObjectPtr>& args);
+
+    ObjectPtr function_;
+    size_t capacity_;
+    // Not interned, since symbols are never freed.
+    std::string name_;
+    // Most recently used first. Only the entries own their arguments.
+    std::list<Entry> entries_;
+    std::unordered_map<ArgumentsKey, std::list<Entry>::iterator, KeyHash, KeyEqual> index_;
+    uint64_t hits_ = 0;
+    uint64_t misses_ = 0;
+    uint64_t evictions_ = 0;
+    mutable std::mutex mutex_;
+};
+
+// Number of results a memoized function keeps unless told otherwise.
+constexpr size_t kDefaultMemoCapacity = 1024;
+
+// (memoize function [capacity]) wraps function with a result cache.
+class MemoizeFunction : public Function {
+public:
+    ObjectPtr Apply(Context* context, const std::vector<ObjectPtr>& args) override;
+};
+
+// (memoize-stats function) gives the counters of a memoized function as an
+// association list.
+class MemoStatsFunction : public Function {
+public:
+    ObjectPtr Apply(Context* context, const std::vector<ObjectPtr>& args) override;
+};
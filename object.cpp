@@ -1,42 +1,56 @@
 #include "object.h"
 #include "error.h"
-#include "functions.h"
+#include "analyzer.h"
 #include "scope.h"
+#include "printer.h"
+#include "parallel.h"
+#include "hash_table.h"
+#include "memoize.h"
+#include <charconv>
+#include <cmath>
+#include <mutex>
 #include <string>
+#include <unordered_map>
 
 // Abstract Object
 
-ObjectPtr Object::Apply(ObjectPtr) {
+ObjectPtr Object::Apply(Context*, const std::vector<ObjectPtr>&) {
     throw RuntimeError("Object is not a function");
 }
 
-ObjectPtr Lambda::Apply(ObjectPtr obj) {
-    std::vector<ObjectPtr> args = GetArgList(obj);
-    if (args.size() != initialize_list_.size()) {
-        throw RuntimeError("Expected " + std::to_string(initialize_list_.size()) +
-                           " arguments in lambda, got " + std::to_string(args.size()));
-    }
-    EvaluateArgs(args);
+ObjectPtr Lambda::Apply(Context* context, const std::vector<ObjectPtr>& args) {
+    return CallLambda(context, std::static_pointer_cast<Lambda>(shared_from_this()), args);
+}
 
-    std::shared_ptr<Scope> prev_scope = GetCurrentScope();
-    SetCurrentScope(std::make_shared<Scope>());
-    GetCurrentScope()->SetPreviousScope(scope_);
+std::string_view Lambda::GetName() const {
+    const Symbol* name = code_->GetName();
+    return name ? std::string_view(name->GetName()) : "lambda";
+}
 
-    for (size_t i = 0; i < initialize_list_.size(); ++i) {
-        GetCurrentScope()->Define(initialize_list_[i], args[i]);
-    }
-    std::vector<ObjectPtr> evaluate_list = GetArgList(body_);
-    ObjectPtr res;
+const std::shared_ptr<LambdaNode>& Lambda::GetCode() const {
+    return code_;
+}
 
-    std::shared_ptr<Scope> test = GetCurrentScope();
+const std::shared_ptr<Frame>& Lambda::GetFrame() const {
+    return frame_;
+}
 
-    for (auto e : evaluate_list) {
-        res = e->Evaluate();
+void Lambda::Traverse(const std::function<void(Collectable*)>& visit) {
+    if (frame_) {
+        visit(frame_.get());
     }
+}
 
-    SetCurrentScope(prev_scope);
+void Lambda::Clear() {
+    frame_.reset();
+}
 
-    return res;
+long Lambda::UseCount() const {
+    return weak_from_this().use_count();
+}
+
+std::shared_ptr<void> Lambda::Hold() {
+    return shared_from_this();
 }
 
 // Number
@@ -49,8 +63,19 @@ std::string Number::ToString() const {
     return std::to_string(value_);
 }
 
-ObjectPtr Number::Evaluate() {
-    return std::make_shared<Number>(value_);
+ObjectPtr MakeNumber(int64_t value) {
+    static const std::vector<ObjectPtr> kCache = [] {
+        std::vector<ObjectPtr> cache;
+        cache.reserve(kMaxCachedNumber - kMinCachedNumber + 1);
+        for (int64_t i = kMinCachedNumber; i <= kMaxCachedNumber; ++i) {
+            cache.push_back(MakeObject<Number>(i));
+        }
+        return cache;
+    }();
+    if (value >= kMinCachedNumber && value <= kMaxCachedNumber) {
+        return kCache[value - kMinCachedNumber];
+    }
+    return MakeObject<Number>(value);
 }
 
 // Symbol
@@ -59,15 +84,122 @@ const std::string& Symbol::GetName() const {
     return name_;
 }
 
+size_t Symbol::GetId() const {
+    return id_;
+}
+
+std::string BigNumber::ToString() const {
+    return value_.ToString();
+}
+
+const BigInteger& BigNumber::GetValue() const {
+    return value_;
+}
+
+ObjectPtr MakeInteger(BigInteger value) {
+    if (std::optional<int64_t> fixnum = value.ToInt64()) {
+        return MakeNumber(*fixnum);
+    }
+    return MakeObject<BigNumber>(std::move(value));
+}
+
+BigInteger GetBigInteger(const ObjectPtr& obj) {
+    if (const BigNumber* number = Cast<BigNumber>(obj)) {
+        return number->GetValue();
+    }
+    return Cast<Number>(obj)->GetValue();
+}
+
+// Shortest representation that reads back as the same double, always with a
+// decimal point or an exponent so that it does not read as an integer.
+static void WriteReal(double value, std::string* out) {
+    if (std::isnan(value)) {
+        *out += "+nan.0";
+        return;
+    }
+    if (std::isinf(value)) {
+        *out += value > 0 ? "+inf.0" : "-inf.0";
+        return;
+    }
+    char buffer[32];
+    auto [end, error] = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    std::string_view digits(buffer, end - buffer);
+    *out += digits;
+    if (digits.find_first_of(".e") == std::string_view::npos) {
+        *out += ".0";
+    }
+}
+
+std::string Real::ToString() const {
+    std::string result;
+    WriteReal(value_, &result);
+    return result;
+}
+
+double Real::GetValue() const {
+    return value_;
+}
+
+double GetDouble(const ObjectPtr& obj) {
+    switch (obj->GetType()) {
+        case ObjectType::kNumber:
+            return static_cast<double>(Cast<Number>(obj)->GetValue());
+        case ObjectType::kBigNumber:
+            return Cast<BigNumber>(obj)->GetValue().ToDouble();
+        default:
+            return Cast<Real>(obj)->GetValue();
+    }
+}
+
+std::string NumericVector::ToString() const {
+    std::string result = "#f64(";
+    for (size_t i = 0; i < values_.size(); ++i) {
+        if (i > 0) {
+            result += ' ';
+        }
+        WriteReal(values_[i], &result);
+    }
+    result += ')';
+    return result;
+}
+
+const std::vector<double>& NumericVector::GetValues() const {
+    return values_;
+}
+
+std::vector<double>& NumericVector::GetValues() {
+    return values_;
+}
+
 std::string Symbol::ToString() const {
     return name_;
 }
 
-ObjectPtr Symbol::Evaluate() {
-    if (name_ == "#t" || name_ == "#f") {
-        return std::make_shared<Symbol>(name_);
+namespace {
+
+// Lets the symbol table be searched by string_view without building a string.
+struct StringHash {
+    using is_transparent = void;
+
+    size_t operator()(std::string_view s) const {
+        return std::hash<std::string_view>()(s);
     }
-    return GetCurrentScope()->Get(name_);
+};
+
+}  // namespace
+
+// The symbol table is shared by all interpreters of the process.
+SymbolPtr Intern(std::string_view name) {
+    static std::mutex mutex;
+    static std::unordered_map<std::string, SymbolPtr, StringHash, std::equal_to<>> symbols;
+    std::lock_guard lock(mutex);
+    if (auto it = symbols.find(name); it != symbols.end()) {
+        return it->second;
+    }
+    std::string key(name);
+    SymbolPtr symbol = MakeObject<Symbol>(key, symbols.size());
+    symbols.emplace(std::move(key), symbol);
+    return symbol;
 }
 
 // Function
@@ -76,12 +208,42 @@ std::string Function::ToString() const {
     return "Function";
 }
 
-ObjectPtr Function::Evaluate() {
-    throw RuntimeError("Functions are not evaluable");
+std::string_view Function::GetName() const {
+    return name_ ? std::string_view(name_->GetName()) : "builtin";
+}
+
+void Function::SetName(const Symbol* name) {
+    name_ = name;
 }
 
 // Cell
 
+// Destroying a long list recursively would overflow the stack, so cells that
+// die together with this one are unlinked and destroyed in a loop.
+Cell::~Cell() {
+    auto is_last_owner = [](const ObjectPtr& obj) {
+        return Is<Cell>(obj) && obj.use_count() == 1;
+    };
+    if (!is_last_owner(first_) && !is_last_owner(second_)) {
+        return;
+    }
+    std::vector<ObjectPtr> dying;
+    auto release = [&](ObjectPtr& obj) {
+        if (is_last_owner(obj)) {
+            dying.push_back(std::move(obj));
+        }
+    };
+    release(first_);
+    release(second_);
+    while (!dying.empty()) {
+        ObjectPtr obj = std::move(dying.back());
+        dying.pop_back();
+        Cell* cell = static_cast<Cell*>(obj.get());
+        release(cell->first_);
+        release(cell->second_);
+    }
+}
+
 ObjectPtr Cell::GetFirst() const {
     return first_;
 }
@@ -98,60 +260,84 @@ ObjectPtr& Cell::GetSecond() {
     return second_;
 }
 
-std::string Cell::ToStringInner() const {
-    std::string res;
-    res += GetFirst()->ToString();
-    if (!GetSecond()) {
-        return res;
-    } else if (Is<Cell>(GetSecond())) {
-        res += " " + As<Cell>(GetSecond())->ToStringInner();
-    } else {
-        res += " . " + GetSecond()->ToString();
-    }
-    return res;
+void Cell::Traverse(const std::function<void(Collectable*)>& visit) {
+    VisitCollectable(first_, visit);
+    VisitCollectable(second_, visit);
 }
 
-std::string Cell::ToString() const {
-    if (!GetFirst()) {
-        size_t cnt = 2;
-        ObjectPtr cell = GetSecond();
-        while (cell) {
-            if (!Is<Cell>(As<Cell>(cell)->GetSecond())) {
-                throw RuntimeError("");
-            } else {
-                ++cnt;
-                cell = As<Cell>(cell)->GetSecond();
-            }
-        }
-        std::string res;
-        for (size_t i = 0; i < cnt; ++i) {
-            res += "(";
-        }
-        for (size_t i = 0; i < cnt; ++i) {
-            res += ")";
-        }
-        return res;
-    }
-    std::string res = "(" + GetFirst()->ToString();
-    if (!GetSecond()) {
-        res += ")";
-        return res;
-    } else if (Is<Cell>(GetSecond())) {
-        res += " " + As<Cell>(GetSecond())->ToStringInner();
-    } else {
-        res += " . " + GetSecond()->ToString();
+void Cell::Clear() {
+    first_.reset();
+    second_.reset();
+}
+
+long Cell::UseCount() const {
+    return weak_from_this().use_count();
+}
+
+std::shared_ptr<void> Cell::Hold() {
+    return shared_from_this();
+}
+
+// Vector
+
+std::string Vector::ToString() const {
+    return PrintToString(std::const_pointer_cast<Object>(shared_from_this()));
+}
+
+const std::vector<ObjectPtr>& Vector::GetElements() const {
+    return elements_;
+}
+
+std::vector<ObjectPtr>& Vector::GetElements() {
+    return elements_;
+}
+
+void Vector::Traverse(const std::function<void(Collectable*)>& visit) {
+    for (const ObjectPtr& element : elements_) {
+        VisitCollectable(element, visit);
     }
-    res += ")";
-    return res;
 }
 
-ObjectPtr Cell::Evaluate() {
-    if (!GetFirst()) {
-        throw RuntimeError("Lists are not self evaluating");
+void Vector::Clear() {
+    elements_.clear();
+}
+
+long Vector::UseCount() const {
+    return weak_from_this().use_count();
+}
+
+std::shared_ptr<void> Vector::Hold() {
+    return shared_from_this();
+}
+
+void VisitCollectable(const ObjectPtr& obj, const std::function<void(Collectable*)>& visit) {
+    if (!obj) {
+        return;
     }
-    ObjectPtr function = GetFirst()->Evaluate();
-    if (!function) {
-        throw RuntimeError("Object is not a function");
+    switch (obj->GetType()) {
+        case ObjectType::kCell:
+            visit(static_cast<Cell*>(obj.get()));
+            break;
+        case ObjectType::kVector:
+            visit(static_cast<Vector*>(obj.get()));
+            break;
+        case ObjectType::kHashTable:
+            visit(static_cast<HashTable*>(obj.get()));
+            break;
+        case ObjectType::kLambda:
+            visit(static_cast<Lambda*>(obj.get()));
+            break;
+        case ObjectType::kMemoizedFunction:
+            visit(static_cast<MemoizedFunction*>(obj.get()));
+            break;
+        case ObjectType::kFuture:
+            visit(static_cast<Future*>(obj.get()));
+            break;
+        default:
+            break;
     }
-    return function->Apply(GetSecond());
+}
+
+std::string Cell::ToString() const {
+    return PrintToString(std::const_pointer_cast<Object>(shared_from_this()));
 }
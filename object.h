@@ -1,104 +1,303 @@
 #pragma once
 
+#include <cstdint>
 #include <memory>
+#include <string>
+#include <string_view>
 #include <vector>
+#include "allocator.h"
+#include "big_integer.h"
+#include "gc.h"
 
 class Object;
-class Scope;
+class Context;
+class Frame;
+class LambdaNode;
+class Symbol;
 
 using ObjectPtr = std::shared_ptr<Object>;
 
+// Concrete type of an object, checked by Is and As instead of RTTI.
+enum class ObjectType : uint8_t {
+    kNumber,
+    kBigNumber,
+    kReal,
+    kNumericVector,
+    kSymbol,
+    kCell,
+    kVector,
+    kHashTable,
+    kFunction,
+    kLambda,
+    kMemoizedFunction,
+    kFuture
+};
+
 class Object : public std::enable_shared_from_this<Object> {
 public:
+    explicit Object(ObjectType type) : type_(type) {
+    }
     virtual ~Object() = default;
     virtual std::string ToString() const = 0;
-    virtual ObjectPtr Evaluate() = 0;
-    virtual ObjectPtr Apply(ObjectPtr);
+    virtual ObjectPtr Apply(Context* context, const std::vector<ObjectPtr>& args);
+
+    ObjectType GetType() const {
+        return type_;
+    }
+    static bool IsInstance(ObjectType) {
+        return true;
+    }
+
+private:
+    ObjectType type_;
 };
 
 class Function : public Object {
 public:
+    explicit Function(ObjectType type = ObjectType::kFunction) : Object(type) {
+    }
     std::string ToString() const override;
-    ObjectPtr Evaluate() override;
+
+    static bool IsInstance(ObjectType type) {
+        return type == ObjectType::kFunction || type == ObjectType::kLambda ||
+               type == ObjectType::kMemoizedFunction;
+    }
+
+    // Name the function is reported under by the profiler.
+    virtual std::string_view GetName() const;
+    void SetName(const Symbol* name);
+
+private:
+    const Symbol* name_ = nullptr;
 };
 
-class Lambda : public Function {
+class Lambda : public Function, public Collectable {
 public:
-    Lambda(ObjectPtr body, const std::vector<std::string>& list, std::shared_ptr<Scope> scope)
-        : body_(body), initialize_list_(list), scope_(scope) {
+    Lambda(std::shared_ptr<LambdaNode> code, std::shared_ptr<Frame> frame)
+        : Function(ObjectType::kLambda), code_(code), frame_(frame) {
+    }
+
+    static bool IsInstance(ObjectType type) {
+        return type == ObjectType::kLambda;
     }
 
-    ObjectPtr Apply(ObjectPtr obj);
+    ObjectPtr Apply(Context* context, const std::vector<ObjectPtr>& args) override;
+    std::string_view GetName() const override;
+
+    const std::shared_ptr<LambdaNode>& GetCode() const;
+    const std::shared_ptr<Frame>& GetFrame() const;
+
+    void Traverse(const std::function<void(Collectable*)>& visit) override;
+    void Clear() override;
+    long UseCount() const override;
+    std::shared_ptr<void> Hold() override;
 
 private:
-    ObjectPtr body_;
-    std::vector<std::string> initialize_list_;
-    std::shared_ptr<Scope> scope_;
+    std::shared_ptr<LambdaNode> code_;
+    std::shared_ptr<Frame> frame_;
 };
 
 class Number : public Object {
 public:
-    Number() = default;
-    Number(int64_t value) : value_(value) {
+    Number(int64_t value = 0) : Object(ObjectType::kNumber), value_(value) {
+    }
+    static bool IsInstance(ObjectType type) {
+        return type == ObjectType::kNumber;
     }
     std::string ToString() const override;
-    ObjectPtr Evaluate() override;
     int64_t GetValue() const;
 
 private:
     int64_t value_;
 };
 
+// Integer out of the range of Number. Arithmetic promotes results that
+// overflow int64_t to big numbers and demotes them back once they fit, so a
+// value has exactly one representation.
+class BigNumber : public Object {
+public:
+    explicit BigNumber(BigInteger value)
+        : Object(ObjectType::kBigNumber),
+          value_(std::move(value)),
+          owned_memory_(value_.GetMemorySize()) {
+    }
+    static bool IsInstance(ObjectType type) {
+        return type == ObjectType::kBigNumber;
+    }
+    std::string ToString() const override;
+    const BigInteger& GetValue() const;
+
+private:
+    BigInteger value_;
+    OwnedMemory owned_memory_;
+};
+
+// Either representation of an integer, for Is<Integer>.
+struct Integer {
+    static bool IsInstance(ObjectType type) {
+        return type == ObjectType::kNumber || type == ObjectType::kBigNumber;
+    }
+};
+
+// Inexact number. Arithmetic on integers and reals gives a real.
+class Real : public Object {
+public:
+    explicit Real(double value) : Object(ObjectType::kReal), value_(value) {
+    }
+    static bool IsInstance(ObjectType type) {
+        return type == ObjectType::kReal;
+    }
+    std::string ToString() const override;
+    double GetValue() const;
+
+private:
+    double value_;
+};
+
+// Any number, for Is<RealNumber>: integers and reals.
+struct RealNumber {
+    static bool IsInstance(ObjectType type) {
+        return Integer::IsInstance(type) || type == ObjectType::kReal;
+    }
+};
+
+// Value of a number as a double.
+double GetDouble(const ObjectPtr& obj);
+
+// Homogeneous vector of doubles, written as in SRFI 4: #f64(1.0 2.5).
+// Arithmetic builtins apply to whole vectors elementwise, broadcasting
+// numbers, with the kernels of simd.h.
+class NumericVector : public Object {
+public:
+    explicit NumericVector(std::vector<double> values)
+        : Object(ObjectType::kNumericVector),
+          values_(std::move(values)),
+          owned_memory_(values_.capacity() * sizeof(double)) {
+    }
+    static bool IsInstance(ObjectType type) {
+        return type == ObjectType::kNumericVector;
+    }
+    std::string ToString() const override;
+    const std::vector<double>& GetValues() const;
+    std::vector<double>& GetValues();
+
+private:
+    std::vector<double> values_;
+    OwnedMemory owned_memory_;
+};
+
 class Symbol : public Object {
 public:
-    Symbol() = default;
-    Symbol(const std::string& s) : name_(s) {
+    Symbol(const std::string& s, size_t id) : Object(ObjectType::kSymbol), name_(s), id_(id) {
+    }
+    static bool IsInstance(ObjectType type) {
+        return type == ObjectType::kSymbol;
     }
     std::string ToString() const override;
-    ObjectPtr Evaluate() override;
     const std::string& GetName() const;
+    size_t GetId() const;
 
 private:
     std::string name_;
+    size_t id_;
 };
 
-class Cell : public Object {
+// Numbers in [kMinCachedNumber, kMaxCachedNumber] are preallocated and shared,
+// so the common small results of arithmetic and parsing allocate nothing.
+constexpr int64_t kMinCachedNumber = -1024;
+constexpr int64_t kMaxCachedNumber = 1024;
+
+ObjectPtr MakeNumber(int64_t value);
+
+// Number if value fits into int64_t, BigNumber otherwise.
+ObjectPtr MakeInteger(BigInteger value);
+
+// Value of a Number or BigNumber.
+BigInteger GetBigInteger(const ObjectPtr& obj);
+
+using SymbolPtr = std::shared_ptr<Symbol>;
+
+// Symbols are interned: equal names always give the same Symbol, so symbols
+// can be compared by pointer and keyed by id.
+SymbolPtr Intern(std::string_view name);
+
+class Cell : public Object, public Collectable {
 public:
-    Cell() = default;
-    Cell(const ObjectPtr& f, const ObjectPtr& s) : first_(f), second_(s) {
+    Cell() : Object(ObjectType::kCell) {
+    }
+    Cell(const ObjectPtr& f, const ObjectPtr& s)
+        : Object(ObjectType::kCell), first_(f), second_(s) {
+    }
+    ~Cell() override;
+    static bool IsInstance(ObjectType type) {
+        return type == ObjectType::kCell;
     }
 
-    std::string ToStringInner() const;
     std::string ToString() const override;
 
-    ObjectPtr Evaluate() override;
-
     ObjectPtr GetFirst() const;
     ObjectPtr GetSecond() const;
 
     ObjectPtr& GetFirst();
     ObjectPtr& GetSecond();
 
+    void Traverse(const std::function<void(Collectable*)>& visit) override;
+    void Clear() override;
+    long UseCount() const override;
+    std::shared_ptr<void> Hold() override;
+
 private:
     ObjectPtr first_, second_;
 };
 
+// Fixed-length array of objects with constant-time indexed access, written
+// as #(1 2 3). Its elements may refer back to it, so it is collectable.
+class Vector : public Object, public Collectable {
+public:
+    explicit Vector(std::vector<ObjectPtr> elements = {})
+        : Object(ObjectType::kVector),
+          elements_(std::move(elements)),
+          owned_memory_(elements_.capacity() * sizeof(ObjectPtr)) {
+    }
+    static bool IsInstance(ObjectType type) {
+        return type == ObjectType::kVector;
+    }
+
+    std::string ToString() const override;
+
+    const std::vector<ObjectPtr>& GetElements() const;
+    std::vector<ObjectPtr>& GetElements();
+
+    void Traverse(const std::function<void(Collectable*)>& visit) override;
+    void Clear() override;
+    long UseCount() const override;
+    std::shared_ptr<void> Hold() override;
+
+private:
+    std::vector<ObjectPtr> elements_;
+    OwnedMemory owned_memory_;
+};
+
+// Calls visit if obj is tracked by the cycle collector.
+void VisitCollectable(const ObjectPtr& obj, const std::function<void(Collectable*)>& visit);
+
 ///////////////////////////////////////////////////////////////////////////////
 
 // Runtime type checking and convertion.
-// This can be helpful: https://en.cppreference.com/w/cpp/memory/shared_ptr/pointer_cast
+// Checks compare the type tag; Cast gives a raw pointer without touching the
+// reference count, As a new owning pointer. Both return null on mismatch.
 
 template <class T>
-std::shared_ptr<T> As(const ObjectPtr& obj) {
-    return std::dynamic_pointer_cast<T>(obj);
+bool Is(const ObjectPtr& obj) {
+    return obj && T::IsInstance(obj->GetType());
 }
 
 template <class T>
-bool Is(const ObjectPtr& obj) {
-    try {
-        std::shared_ptr<T> tmp = As<T>(obj);
-        return tmp.get();
-    } catch (...) {
-        return false;
-    }
+T* Cast(const ObjectPtr& obj) {
+    return Is<T>(obj) ? static_cast<T*>(obj.get()) : nullptr;
+}
+
+template <class T>
+std::shared_ptr<T> As(const ObjectPtr& obj) {
+    return Is<T>(obj) ? std::static_pointer_cast<T>(obj) : nullptr;
 }
@@ -0,0 +1,192 @@
+#include "parallel.h"
+#include "context.h"
+#include "error.h"
+#include "functions.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <chrono>
+
+namespace {
+
+// Chunks per worker in pmap, so that uneven calls still balance.
+constexpr size_t kChunksPerWorker = 4;
+
+// Waits until done returns true, running queued tasks of group meanwhile.
+template <class Predicate>
+void HelpUntil(Predicate done, const ThreadPool::Group* group, std::mutex* mutex,
+               std::condition_variable* condition) {
+    while (!done()) {
+        if (ThreadPool::Instance().RunPendingTask(group)) {
+            continue;
+        }
+        std::unique_lock lock(*mutex);
+        condition->wait_for(lock, std::chrono::milliseconds(1), done);
+    }
+}
+
+// Shared state of the chunks of one pmap call. Chunks keep it alive, since
+// the caller may return as soon as the last chunk has counted itself off.
+struct MapBatch {
+    // Group of the chunks.
+    ThreadPool::GroupPtr group;
+    ObjectPtr function;
+    std::vector<ObjectPtr> items;
+    std::vector<ObjectPtr> results;
+    std::atomic<size_t> remaining;
+    std::atomic<bool> failed = false;
+    std::exception_ptr error;
+    std::mutex mutex;
+    std::condition_variable done;
+};
+
+void MapChunk(Context* context, size_t begin, size_t end, MapBatch* batch) {
+    try {
+        for (size_t i = begin; i < end && !batch->failed.load(); ++i) {
+            batch->results[i] = batch->function->Apply(context, {batch->items[i]});
+        }
+    } catch (...) {
+        std::lock_guard lock(batch->mutex);
+        if (!batch->failed.exchange(true)) {
+            batch->error = std::current_exception();
+        }
+    }
+    std::lock_guard lock(batch->mutex);
+    if (batch->remaining.fetch_sub(1) == 1) {
+        batch->done.notify_all();
+    }
+}
+
+}  // namespace
+
+std::string Future::ToString() const {
+    return "#<future>";
+}
+
+void Future::Run(Context* context) {
+    State expected = kPending;
+    if (!state_.compare_exchange_strong(expected, kRunning)) {
+        return;
+    }
+    try {
+        // Tasks the thunk spawns are nested in its group wherever it runs.
+        ThreadPool::GroupScope scope(group_);
+        value_ = thunk_->Apply(context, {});
+    } catch (...) {
+        error_ = std::current_exception();
+    }
+    thunk_.reset();
+    std::lock_guard lock(mutex_);
+    state_.store(kDone);
+    done_.notify_all();
+}
+
+ObjectPtr Future::Touch(Context* context) {
+    Run(context);
+    HelpUntil([this] { return state_.load() == kDone; }, group_.get(), &mutex_, &done_);
+    if (error_) {
+        std::rethrow_exception(error_);
+    }
+    return value_;
+}
+
+// Collections only run while no task is running, so the thunk and the value
+// are not changing under them.
+void Future::Traverse(const std::function<void(Collectable*)>& visit) {
+    VisitCollectable(thunk_, visit);
+    VisitCollectable(value_, visit);
+}
+
+void Future::Clear() {
+    thunk_.reset();
+    value_.reset();
+}
+
+long Future::UseCount() const {
+    return weak_from_this().use_count();
+}
+
+std::shared_ptr<void> Future::Hold() {
+    return shared_from_this();
+}
+
+void SpawnTask(Context* context, ThreadPool::GroupPtr group,
+               std::function<void(Context*)> body) {
+    Context* root = context->GetRoot();
+    root->BeginTask();
+    ThreadPool::Instance().Submit(
+        [root, limits = context->GetTaskLimits(), body = std::move(body)]() mutable {
+            {
+                Context task_context(root, limits);
+                ContextGuard guard(&task_context);
+                body(&task_context);
+                body = nullptr;
+            }
+            root->EndTask();
+        },
+        std::move(group));
+}
+
+ObjectPtr FutureFunction::Apply(Context* context, const std::vector<ObjectPtr>& args) {
+    CheckArgumentsCount<RuntimeError>(args, 1, 1);
+    if (!Is<Function>(args[0])) {
+        throw RuntimeError("future expects a procedure");
+    }
+    ThreadPool::GroupPtr group = ThreadPool::NewGroup();
+    auto future = MakeObject<Future>(args[0], group);
+    SpawnTask(context, std::move(group),
+              [future](Context* task_context) { future->Run(task_context); });
+    return future;
+}
+
+ObjectPtr TouchFunction::Apply(Context* context, const std::vector<ObjectPtr>& args) {
+    CheckArgumentsCount<RuntimeError>(args, 1, 1);
+    if (Future* future = Cast<Future>(args[0])) {
+        return future->Touch(context);
+    }
+    return args[0];
+}
+
+// The calling thread maps the first chunk itself and then helps with the
+// rest, so pmap inside pmap cannot starve the pool.
+ObjectPtr PMapFunction::Apply(Context* context, const std::vector<ObjectPtr>& args) {
+    CheckArgumentsCount<RuntimeError>(args, 2, 2);
+    if (!Is<Function>(args[0])) {
+        throw RuntimeError("pmap expects a procedure");
+    }
+    std::optional<size_t> length = GetListLength(args[1]);
+    if (!length) {
+        throw RuntimeError("pmap expects a list");
+    }
+    // Items and results.
+    context->CheckAllocation(*length, 2 * sizeof(ObjectPtr));
+    auto batch = std::make_shared<MapBatch>();
+    batch->group = ThreadPool::NewGroup();
+    batch->function = args[0];
+    batch->items = GetArgList(args[1]);
+    size_t count = batch->items.size();
+    if (count == 0) {
+        return nullptr;
+    }
+    batch->results.resize(count);
+
+    size_t chunks = std::min(count, ThreadPool::Instance().GetWorkersCount() * kChunksPerWorker);
+    size_t chunk_size = (count + chunks - 1) / chunks;
+    batch->remaining = (count + chunk_size - 1) / chunk_size;
+    for (size_t begin = chunk_size; begin < count; begin += chunk_size) {
+        size_t end = std::min(begin + chunk_size, count);
+        SpawnTask(context, batch->group, [batch, begin, end](Context* task_context) {
+            MapChunk(task_context, begin, end, batch.get());
+        });
+    }
+    {
+        ThreadPool::GroupScope scope(batch->group);
+        MapChunk(context, 0, chunk_size, batch.get());
+    }
+    HelpUntil([&batch] { return batch->remaining.load() == 0; }, batch->group.get(),
+              &batch->mutex, &batch->done);
+
+    if (batch->error) {
+        std::rethrow_exception(batch->error);
+    }
+    return GetListFromArgs(batch->results);
+}
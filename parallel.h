@@ -0,0 +1,71 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include "object.h"
+#include "thread_pool.h"
+
+// Value of a thunk that is computed by the thread pool in the background.
+// The first thread to get to the thunk runs it: a worker of the pool, or
+// the thread touching the future if no worker has started it yet.
+class Future : public Object, public Collectable {
+public:
+    Future(ObjectPtr thunk, ThreadPool::GroupPtr group)
+        : Object(ObjectType::kFuture), thunk_(std::move(thunk)), group_(std::move(group)) {
+    }
+    static bool IsInstance(ObjectType type) {
+        return type == ObjectType::kFuture;
+    }
+
+    std::string ToString() const override;
+
+    // Runs the thunk unless some thread has already started it.
+    void Run(Context* context);
+
+    // Waits for the value, helping the pool with the tasks the thunk spawned
+    // meanwhile. Errors raised by the thunk are rethrown here.
+    ObjectPtr Touch(Context* context);
+
+    void Traverse(const std::function<void(Collectable*)>& visit) override;
+    void Clear() override;
+    long UseCount() const override;
+    std::shared_ptr<void> Hold() override;
+
+private:
+    enum State { kPending, kRunning, kDone };
+
+    std::atomic<State> state_ = kPending;
+    ObjectPtr thunk_;
+    // Group of the task running the thunk.
+    ThreadPool::GroupPtr group_;
+    ObjectPtr value_;
+    std::exception_ptr error_;
+    std::mutex mutex_;
+    std::condition_variable done_;
+};
+
+// Runs body on the thread pool, as part of group, with a task context of the
+// context's interpreter under the limits of its evaluation. Everything body
+// captured is released before the task is reported as finished.
+void SpawnTask(Context* context, ThreadPool::GroupPtr group, std::function<void(Context*)> body);
+
+// (future thunk) starts computing (thunk) in the background.
+class FutureFunction : public Function {
+public:
+    ObjectPtr Apply(Context* context, const std::vector<ObjectPtr>& args) override;
+};
+
+// (touch value) gives the value of a future; other values are returned as is.
+class TouchFunction : public Function {
+public:
+    ObjectPtr Apply(Context* context, const std::vector<ObjectPtr>& args) override;
+};
+
+// (pmap function list) is map with the calls spread over the thread pool.
+class PMapFunction : public Function {
+public:
+    ObjectPtr Apply(Context* context, const std::vector<ObjectPtr>& args) override;
+};
@@ -1,74 +1,169 @@
 #include "parser.h"
 #include "tokenizer.h"
 #include "error.h"
+#include <vector>
 
-ObjectPtr ReadList(Tokenizer* tokenizer);
+namespace {
 
-ObjectPtr Read(Tokenizer* tokenizer) {
-    if (tokenizer->IsEnd()) {
-        throw SyntaxError("");
-    }
-    Token current_token = tokenizer->GetToken();
-    tokenizer->Next();
-    if (current_token == Token{BracketToken{BracketToken::CLOSE}}) {
-        throw SyntaxError("");
-    } else if (current_token == Token{BracketToken{BracketToken::OPEN}}) {
-        return ReadList(tokenizer);
-    } else if (current_token == Token{QuoteToken{}}) {
-        if (tokenizer->IsEnd() ||
-            tokenizer->GetToken() == Token{BracketToken{BracketToken::CLOSE}}) {
-            throw SyntaxError("");
-        }
-        ObjectPtr cell = std::make_shared<Cell>();
-        As<Cell>(cell)->GetFirst() = std::make_shared<Symbol>("quote");
-        As<Cell>(cell)->GetSecond() = std::make_shared<Cell>();
-        As<Cell>(As<Cell>(cell)->GetSecond())->GetFirst() = Read(tokenizer);
-        return cell;
-    } else if (SymbolToken* x = std::get_if<SymbolToken>(&current_token)) {
-        return std::make_shared<Symbol>(x->name);
-    } else if (ConstantToken* y = std::get_if<ConstantToken>(&current_token)) {
-        return std::make_shared<Number>(y->value);
-    } else {
-        throw SyntaxError("");
-    }
+// Datum whose reading has started but not finished yet.
+struct PendingDatum {
+    enum Kind { kList, kDottedTail, kQuote, kVector };
+
+    Kind kind;
+    ObjectPtr head = nullptr;
+    Cell* tail = nullptr;
+    std::vector<ObjectPtr> elements{};
+};
+
+bool IsCloseBracket(Tokenizer* tokenizer) {
+    return tokenizer->GetToken() == Token{BracketToken{BracketToken::CLOSE}};
 }
 
-ObjectPtr ReadList(Tokenizer* tokenizer) {
-    if (tokenizer->IsEnd()) {
-        throw SyntaxError("");
-    } else if (tokenizer->GetToken() == Token{BracketToken{BracketToken::CLOSE}}) {
+// Reads the elements of a numeric vector literal up to its closing bracket.
+// They can only be numbers, so they need no stack.
+std::vector<double> ReadNumericValues(Tokenizer* tokenizer) {
+    std::vector<double> values;
+    while (true) {
+        if (tokenizer->IsEnd()) {
+            throw SyntaxError("");
+        }
+        const Token& token = tokenizer->GetToken();
+        if (IsCloseBracket(tokenizer)) {
+            tokenizer->Next();
+            return values;
+        } else if (const ConstantToken* x = std::get_if<ConstantToken>(&token)) {
+            values.push_back(x->value);
+        } else if (const BigConstantToken* y = std::get_if<BigConstantToken>(&token)) {
+            values.push_back(BigInteger::Parse(y->digits).ToDouble());
+        } else if (const RealToken* z = std::get_if<RealToken>(&token)) {
+            values.push_back(z->value);
+        } else {
+            throw SyntaxError("Elements of #f64 literals should be numbers");
+        }
         tokenizer->Next();
-        return ObjectPtr();
     }
+}
 
-    ObjectPtr root_cell = std::make_shared<Cell>();
-    ObjectPtr current_cell = root_cell;
+}  // namespace
 
-    for (Token t = tokenizer->GetToken(); t != Token{BracketToken{BracketToken::CLOSE}};
-         t = tokenizer->GetToken()) {
-        ObjectPtr val = Read(tokenizer);
-        As<Cell>(current_cell)->GetFirst() = val;
+// Lists, vectors and quotes are kept on an explicit stack instead of the call stack,
+// so the nesting depth of the input is only limited by memory.
+ObjectPtr Read(Tokenizer* tokenizer) {
+    std::vector<PendingDatum> stack;
+    while (true) {
         if (tokenizer->IsEnd()) {
             throw SyntaxError("");
         }
-        if (tokenizer->GetToken() == Token{DotToken{}}) {  // pair
+        // Symbol names only live until the tokenizer advances.
+        const Token& current_token = tokenizer->GetToken();
+        ObjectPtr value;
+        if (const SymbolToken* x = std::get_if<SymbolToken>(&current_token)) {
+            value = Intern(x->name);
+            tokenizer->Next();
+        } else if (const ConstantToken* y = std::get_if<ConstantToken>(&current_token)) {
+            value = MakeNumber(y->value);
+            tokenizer->Next();
+        } else if (const BigConstantToken* z = std::get_if<BigConstantToken>(&current_token)) {
+            value = MakeObject<BigNumber>(BigInteger::Parse(z->digits));
+            tokenizer->Next();
+        } else if (const RealToken* real = std::get_if<RealToken>(&current_token)) {
+            value = MakeObject<Real>(real->value);
             tokenizer->Next();
-            ObjectPtr second = Read(tokenizer);
-            As<Cell>(current_cell)->GetSecond() = second;
-            if (tokenizer->IsEnd() ||
-                tokenizer->GetToken() != Token{BracketToken{BracketToken::CLOSE}}) {
+        } else if (current_token == Token{BracketToken{BracketToken::OPEN}}) {
+            tokenizer->Next();
+            if (tokenizer->IsEnd()) {
                 throw SyntaxError("");
             }
+            if (!IsCloseBracket(tokenizer)) {
+                stack.push_back(PendingDatum{PendingDatum::kList});
+                continue;
+            }
             tokenizer->Next();
-        } else if (tokenizer->GetToken() == Token{BracketToken{BracketToken::CLOSE}}) {
-            As<Cell>(current_cell)->GetSecond() = ObjectPtr();
+        } else if (current_token == Token{VectorOpenToken{}}) {
             tokenizer->Next();
-            break;
+            if (tokenizer->IsEnd()) {
+                throw SyntaxError("");
+            }
+            if (!IsCloseBracket(tokenizer)) {
+                stack.push_back(PendingDatum{PendingDatum::kVector});
+                continue;
+            }
+            tokenizer->Next();
+            value = MakeObject<Vector>();
+        } else if (current_token == Token{NumericVectorOpenToken{}}) {
+            tokenizer->Next();
+            value = MakeObject<NumericVector>(ReadNumericValues(tokenizer));
+        } else if (current_token == Token{QuoteToken{}}) {
+            tokenizer->Next();
+            if (tokenizer->IsEnd() || IsCloseBracket(tokenizer)) {
+                throw SyntaxError("");
+            }
+            stack.push_back(PendingDatum{PendingDatum::kQuote});
+            continue;
         } else {
-            As<Cell>(current_cell)->GetSecond() = std::make_shared<Cell>();
-            current_cell = As<Cell>(current_cell)->GetSecond();
+            throw SyntaxError("");
         }
-    }
 
-    return root_cell;
+        // Hand the finished datum to the data waiting for it.
+        while (true) {
+            if (stack.empty()) {
+                return value;
+            }
+            PendingDatum& pending = stack.back();
+            if (pending.kind == PendingDatum::kQuote) {
+                static const SymbolPtr kQuote = Intern("quote");
+                value = MakeObject<Cell>(kQuote, MakeObject<Cell>(value, nullptr));
+                stack.pop_back();
+                continue;
+            }
+            if (pending.kind == PendingDatum::kDottedTail) {
+                pending.tail->GetSecond() = value;
+                if (tokenizer->IsEnd() || !IsCloseBracket(tokenizer)) {
+                    throw SyntaxError("");
+                }
+                tokenizer->Next();
+                value = std::move(pending.head);
+                stack.pop_back();
+                continue;
+            }
+            if (pending.kind == PendingDatum::kVector) {
+                pending.elements.push_back(std::move(value));
+                if (tokenizer->IsEnd() || tokenizer->GetToken() == Token{DotToken{}}) {
+                    throw SyntaxError("");
+                }
+                if (IsCloseBracket(tokenizer)) {
+                    tokenizer->Next();
+                    value = MakeObject<Vector>(std::move(pending.elements));
+                    stack.pop_back();
+                    continue;
+                }
+                break;
+            }
+
+            ObjectPtr cell = MakeObject<Cell>(value, nullptr);
+            Cell* new_tail = Cast<Cell>(cell);
+            if (pending.tail) {
+                pending.tail->GetSecond() = std::move(cell);
+            } else {
+                pending.head = std::move(cell);
+            }
+            pending.tail = new_tail;
+
+            if (tokenizer->IsEnd()) {
+                throw SyntaxError("");
+            }
+            if (tokenizer->GetToken() == Token{DotToken{}}) {
+                tokenizer->Next();
+                pending.kind = PendingDatum::kDottedTail;
+                break;
+            }
+            if (IsCloseBracket(tokenizer)) {
+                tokenizer->Next();
+                value = std::move(pending.head);
+                stack.pop_back();
+                continue;
+            }
+            break;
+        }
+    }
 }
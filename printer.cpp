@@ -0,0 +1,210 @@
+#include "printer.h"
+#include <sstream>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+// A cycle can only be entered through a cell or vector with more than one
+// reference, so only such objects need to be remembered while looking for
+// cycles.
+bool IsShared(const ObjectPtr& obj) {
+    return obj.use_count() > 1;
+}
+
+bool IsCompound(const ObjectPtr& obj) {
+    return Is<Cell>(obj) || Is<Vector>(obj);
+}
+
+// Finds the cells and vectors that are reached again while the datum
+// containing them is still being walked, i.e. the targets of back edges.
+class CycleFinder {
+public:
+    std::unordered_map<const Object*, int> Find(const ObjectPtr& root) {
+        Enter(root);
+        while (!stack_.empty()) {
+            CompoundState& state = stack_.back();
+            if (state.vector) {
+                const std::vector<ObjectPtr>& elements = state.vector->GetElements();
+                if (state.index < elements.size()) {
+                    Enter(elements[state.index++]);
+                    continue;
+                }
+            } else if (!state.car_done) {
+                state.car_done = true;
+                Enter(state.cell->GetFirst());
+                continue;
+            } else if (const ObjectPtr& next = state.cell->GetSecond();
+                       Is<Cell>(next) && Mark(next)) {
+                state.cell = Cast<Cell>(next);
+                state.car_done = false;
+                continue;
+            }
+            for (size_t i = state.progress_start; i < in_progress_.size(); ++i) {
+                states_[in_progress_[i]] = kDone;
+            }
+            in_progress_.resize(state.progress_start);
+            stack_.pop_back();
+        }
+        return std::move(labels_);
+    }
+
+private:
+    enum State { kInProgress, kDone };
+
+    // A list being walked along its cdrs, or a vector when vector is set.
+    struct CompoundState {
+        Cell* cell;
+        Vector* vector;
+        bool car_done;
+        size_t index;
+        size_t progress_start;
+    };
+
+    void Enter(const ObjectPtr& obj) {
+        if (!IsCompound(obj)) {
+            return;
+        }
+        size_t progress_start = in_progress_.size();
+        if (Mark(obj)) {
+            stack_.push_back(
+                CompoundState{Cast<Cell>(obj), Cast<Vector>(obj), false, 0, progress_start});
+        }
+    }
+
+    // Returns whether the walk should continue into the object.
+    bool Mark(const ObjectPtr& obj) {
+        if (!IsShared(obj)) {
+            return true;
+        }
+        auto [it, inserted] = states_.try_emplace(obj.get(), kInProgress);
+        if (inserted) {
+            in_progress_.push_back(obj.get());
+            return true;
+        }
+        if (it->second == kInProgress) {
+            labels_.try_emplace(obj.get(), -1);
+        }
+        return false;
+    }
+
+    std::vector<CompoundState> stack_;
+    std::unordered_map<const Object*, State> states_;
+    std::vector<const Object*> in_progress_;
+    std::unordered_map<const Object*, int> labels_;
+};
+
+class Printer {
+public:
+    Printer(std::ostream* out, std::unordered_map<const Object*, int> labels)
+        : out_(out), labels_(std::move(labels)) {
+    }
+
+    void Print(const ObjectPtr& root) {
+        Write(root);
+        while (!stack_.empty()) {
+            CompoundState& state = stack_.back();
+            if (state.stage == kElements) {
+                const std::vector<ObjectPtr>& elements = state.vector->GetElements();
+                if (state.index == elements.size()) {
+                    *out_ << ')';
+                    stack_.pop_back();
+                    continue;
+                }
+                if (state.index > 0) {
+                    *out_ << ' ';
+                }
+                Write(elements[state.index++]);
+                continue;
+            }
+            if (state.stage == kCar) {
+                state.stage = kCdr;
+                Write(state.cell->GetFirst());
+                continue;
+            }
+            if (state.stage == kDottedTail) {
+                *out_ << ')';
+                stack_.pop_back();
+                continue;
+            }
+            const ObjectPtr& next = state.cell->GetSecond();
+            if (!next) {
+                *out_ << ')';
+                stack_.pop_back();
+            } else if (Is<Cell>(next) && !labels_.contains(next.get())) {
+                *out_ << ' ';
+                state.cell = Cast<Cell>(next);
+                state.stage = kCar;
+            } else {
+                // A labeled tail has to start a datum of its own.
+                *out_ << " . ";
+                state.stage = kDottedTail;
+                Write(next);
+            }
+        }
+    }
+
+private:
+    enum Stage { kCar, kCdr, kDottedTail, kElements };
+
+    // A list being written, or a vector in the kElements stage.
+    struct CompoundState {
+        Cell* cell;
+        Vector* vector;
+        Stage stage;
+        size_t index;
+    };
+
+    void Write(const ObjectPtr& obj) {
+        if (!obj) {
+            *out_ << "()";
+            return;
+        }
+        switch (obj->GetType()) {
+            case ObjectType::kNumber:
+                *out_ << Cast<Number>(obj)->GetValue();
+                return;
+            case ObjectType::kSymbol:
+                *out_ << Cast<Symbol>(obj)->GetName();
+                return;
+            case ObjectType::kCell:
+            case ObjectType::kVector:
+                break;
+            default:
+                *out_ << obj->ToString();
+                return;
+        }
+        if (auto it = labels_.find(obj.get()); it != labels_.end()) {
+            if (it->second >= 0) {
+                *out_ << '#' << it->second << '#';
+                return;
+            }
+            it->second = next_label_++;
+            *out_ << '#' << it->second << '=';
+        }
+        if (Vector* vector = Cast<Vector>(obj)) {
+            *out_ << "#(";
+            stack_.push_back(CompoundState{nullptr, vector, kElements, 0});
+        } else {
+            *out_ << '(';
+            stack_.push_back(CompoundState{Cast<Cell>(obj), nullptr, kCar, 0});
+        }
+    }
+
+    std::ostream* out_;
+    std::unordered_map<const Object*, int> labels_;
+    int next_label_ = 0;
+    std::vector<CompoundState> stack_;
+};
+
+}  // namespace
+
+void Print(const ObjectPtr& obj, std::ostream* out) {
+    Printer(out, CycleFinder().Find(obj)).Print(obj);
+}
+
+std::string PrintToString(const ObjectPtr& obj) {
+    std::ostringstream out;
+    Print(obj, &out);
+    return out.str();
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+#include "object.h"
+
+// Writes the external representation of obj. Lists and vectors are walked
+// iteratively, so neither length nor nesting depth is limited by the stack.
+// Pairs and vectors that are part of a cycle are written with datum labels,
+// as R7RS write does: `#0=(1 2 . #0#)`.
+void Print(const ObjectPtr& obj, std::ostream* out);
+
+std::string PrintToString(const ObjectPtr& obj);
@@ -0,0 +1,123 @@
+#include "profiler.h"
+#include "allocator.h"
+#include <algorithm>
+#include <iomanip>
+#include <string>
+
+Profiler::Profiler() {
+    Reset();
+}
+
+void Profiler::Enter(std::string_view name) {
+    auto function = functions_.find(name);
+    if (function == functions_.end()) {
+        function = functions_.try_emplace(*names_.emplace(name).first).first;
+    }
+    name = function->first;
+    size_t parent = calls_.empty() ? 0 : calls_.back().node;
+    auto [child, inserted] = nodes_[parent].children.try_emplace(name, nodes_.size());
+    if (inserted) {
+        nodes_.push_back(StackNode{name, parent});
+    }
+    FunctionStats* stats = &function->second;
+    ++stats->calls;
+    ++active_[stats];
+    calls_.push_back(ActiveCall{child->second, stats, Clock::now(), GetObjectAllocations()});
+}
+
+void Profiler::Leave() {
+    ActiveCall call = calls_.back();
+    calls_.pop_back();
+    auto time = Clock::now() - call.start;
+    uint64_t allocations = GetObjectAllocations() - call.start_allocations;
+
+    auto self_time = time - call.callees_time;
+    call.stats->self_time += self_time;
+    call.stats->self_allocations += allocations - call.callees_allocations;
+    nodes_[call.node].self_time += self_time;
+    if (--active_[call.stats] == 0) {
+        call.stats->total_time += time;
+        call.stats->total_allocations += allocations;
+    }
+    if (!calls_.empty()) {
+        calls_.back().callees_time += time;
+        calls_.back().callees_allocations += allocations;
+    }
+}
+
+size_t Profiler::GetDepth() const {
+    return calls_.size();
+}
+
+void Profiler::Unwind(size_t depth) {
+    while (calls_.size() > depth) {
+        Leave();
+    }
+}
+
+void Profiler::Reset() {
+    functions_.clear();
+    active_.clear();
+    calls_.clear();
+    nodes_.clear();
+    nodes_.push_back(StackNode{"", 0});
+    names_.clear();
+}
+
+const std::unordered_map<std::string_view, Profiler::FunctionStats>& Profiler::GetFunctions()
+    const {
+    return functions_;
+}
+
+void Profiler::WriteReport(std::ostream* out) const {
+    std::vector<std::pair<std::string_view, const FunctionStats*>> rows;
+    for (const auto& [name, stats] : functions_) {
+        rows.emplace_back(name, &stats);
+    }
+    std::sort(rows.begin(), rows.end(), [](const auto& lhs, const auto& rhs) {
+        return lhs.second->self_time > rhs.second->self_time;
+    });
+
+    auto milliseconds = [](std::chrono::nanoseconds time) {
+        return std::chrono::duration<double, std::milli>(time).count();
+    };
+    *out << std::left << std::setw(24) << "function" << std::right << std::setw(12) << "calls"
+         << std::setw(12) << "self ms" << std::setw(12) << "total ms" << std::setw(14)
+         << "self allocs" << std::setw(14) << "total allocs" << "\n";
+    *out << std::fixed << std::setprecision(3);
+    for (const auto& [name, stats] : rows) {
+        *out << std::left << std::setw(24) << name << std::right << std::setw(12) << stats->calls
+             << std::setw(12) << milliseconds(stats->self_time) << std::setw(12)
+             << milliseconds(stats->total_time) << std::setw(14) << stats->self_allocations
+             << std::setw(14) << stats->total_allocations << "\n";
+    }
+    *out << std::defaultfloat;
+}
+
+// The tree is walked with an explicit stack, since deep recursion in the
+// profiled code gives equally deep stacks.
+void Profiler::WriteFoldedStacks(std::ostream* out) const {
+    std::string path;
+    // Node and the length of path before the node's name was appended.
+    std::vector<std::pair<size_t, size_t>> pending;
+    for (const auto& [name, child] : nodes_[0].children) {
+        pending.emplace_back(child, 0);
+    }
+    while (!pending.empty()) {
+        auto [index, prefix_length] = pending.back();
+        pending.pop_back();
+        const StackNode& node = nodes_[index];
+        path.resize(prefix_length);
+        if (!path.empty()) {
+            path += ';';
+        }
+        path += node.name;
+        auto microseconds = std::chrono::duration_cast<std::chrono::microseconds>(node.self_time);
+        if (microseconds.count() > 0) {
+            *out << path << ' ' << microseconds.count() << '\n';
+        }
+        for (const auto& [name, child] : node.children) {
+            pending.emplace_back(child, path.size());
+        }
+    }
+}
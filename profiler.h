@@ -0,0 +1,80 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Instrumenting profiler for Scheme code. The evaluators report every call
+// of a lambda or builtin with Enter and its end with Leave; the profiler
+// attributes wall time and object allocations to the functions by name and
+// to the call stacks they were made from.
+//
+// Names are copied the first time they are entered, so functions may be
+// destroyed before the report.
+class Profiler {
+public:
+    struct FunctionStats {
+        uint64_t calls = 0;
+        // Time and allocations of the function's own code, and including
+        // its callees. Recursive calls are counted once in the totals.
+        std::chrono::nanoseconds self_time{0};
+        std::chrono::nanoseconds total_time{0};
+        uint64_t self_allocations = 0;
+        uint64_t total_allocations = 0;
+    };
+
+    Profiler();
+
+    void Enter(std::string_view name);
+    void Leave();
+
+    // Number of calls entered and not left. Evaluators unwinding because of
+    // an exception leave every call above the depth they started at.
+    size_t GetDepth() const;
+    void Unwind(size_t depth);
+
+    void Reset();
+
+    const std::unordered_map<std::string_view, FunctionStats>& GetFunctions() const;
+
+    // Table of functions sorted by self time.
+    void WriteReport(std::ostream* out) const;
+
+    // One line per call stack with the self time spent in it in
+    // microseconds, `outer;inner 1234`, the folded format read by
+    // flamegraph.pl and speedscope.
+    void WriteFoldedStacks(std::ostream* out) const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct StackNode {
+        std::string_view name;
+        size_t parent;
+        std::unordered_map<std::string_view, size_t> children{};
+        std::chrono::nanoseconds self_time{0};
+    };
+
+    struct ActiveCall {
+        size_t node;
+        FunctionStats* stats;
+        Clock::time_point start;
+        size_t start_allocations;
+        std::chrono::nanoseconds callees_time{0};
+        uint64_t callees_allocations = 0;
+    };
+
+    // Owns the names the other members view.
+    std::unordered_set<std::string> names_;
+    std::unordered_map<std::string_view, FunctionStats> functions_;
+    // Number of active calls per function, to count recursion once.
+    std::unordered_map<const FunctionStats*, size_t> active_;
+    // Tree of call stacks; node 0 is the root.
+    std::vector<StackNode> nodes_;
+    std::vector<ActiveCall> calls_;
+};
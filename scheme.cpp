@@ -1,29 +1,104 @@
-#include <sstream>
 #include "scheme.h"
+#include <ostream>
 #include "tokenizer.h"
 #include "parser.h"
 #include "error.h"
 #include "scope.h"
+#include "analyzer.h"
+#include "bytecode.h"
+#include "vm.h"
+#include "context.h"
+#include "allocator.h"
+#include "source_file.h"
+#include "memoize.h"
+#include "printer.h"
+#include "profiler.h"
 
-Interpreter::Interpreter() {
-    SetCurrentScope(std::make_shared<Scope>());
-    GetCurrentScope()->InitGlobalScope();
+Interpreter::Interpreter(ExecutionMode mode)
+    : mode_(mode), context_(std::make_unique<Context>()) {
 }
 
+Interpreter::~Interpreter() = default;
+
 std::string Interpreter::Run(const std::string &input) {
-    std::stringstream ss{input};
-    Tokenizer tokenizer{&ss};
+    ContextGuard guard(context_.get());
+    context_->StartLimits(limits_);
+    Tokenizer tokenizer{std::string_view(input)};
     auto syntax_tree = Read(&tokenizer);
     if (!tokenizer.IsEnd()) {
         throw SyntaxError("");
     }
+    return PrintToString(Evaluate(syntax_tree));
+}
+
+std::string Interpreter::RunFile(const std::string &path) {
+    ContextGuard guard(context_.get());
+    context_->StartLimits(limits_);
+    MappedFile file(path);
+    Tokenizer tokenizer{file.GetContents()};
+    ObjectPtr res;
+    while (!tokenizer.IsEnd()) {
+        res = Evaluate(Read(&tokenizer));
+    }
+    return PrintToString(res);
+}
+
+void Interpreter::RunStream(std::istream *in, std::ostream *out) {
+    ContextGuard guard(context_.get());
+    Tokenizer tokenizer{in};
+    while (!tokenizer.IsEnd()) {
+        ObjectPtr syntax_tree = Read(&tokenizer);
+        context_->StartLimits(limits_);
+        Print(Evaluate(syntax_tree), out);
+        *out << std::endl;
+    }
+}
+
+ObjectPtr Interpreter::Evaluate(const ObjectPtr &syntax_tree) {
     if (!syntax_tree) {
         throw RuntimeError("Lists are not evaluating");
     }
 
-    auto res = syntax_tree->Evaluate();
-    if (!res) {
-        return "()";
+    NodePtr program = Analyze(syntax_tree);
+    ObjectPtr res;
+    if (mode_ == ExecutionMode::kBytecode) {
+        res = VirtualMachine(context_.get()).Run(*Compile(program), context_->GetCurrentFrame());
+    } else {
+        res = program->Execute(context_.get());
+    }
+    context_->MaybeCollectGarbage();
+    if (trim_pools_) {
+        TrimObjectPools();
+    }
+    return res;
+}
+
+void Interpreter::SetLimits(const EvaluationLimits& limits) {
+    limits_ = limits;
+}
+
+void Interpreter::SetTrimPools(bool trim_pools) {
+    trim_pools_ = trim_pools;
+}
+
+void Interpreter::SetProfiling(bool profiling) {
+    if (!profiling) {
+        profiler_.reset();
+    } else if (!profiler_) {
+        profiler_ = std::make_unique<Profiler>();
+    }
+    context_->SetProfiler(profiler_.get());
+}
+
+Profiler* Interpreter::GetProfiler() {
+    return profiler_.get();
+}
+
+std::optional<MemoStats> Interpreter::GetMemoStats(const std::string& name) {
+    const Scope::Slot* slot = context_->GetGlobals()->Lookup(Intern(name));
+    ObjectPtr value = (slot ? *slot->load(std::memory_order_acquire) : nullptr);
+    if (const MemoizedFunction* function = Cast<MemoizedFunction>(value)) {
+        return function->GetStats();
     }
-    return res->ToString();
+    return std::nullopt;
 }
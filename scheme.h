@@ -1,9 +1,62 @@
 #pragma once
 
+#include <iosfwd>
+#include <memory>
+#include <optional>
 #include <string>
+#include "eval_limits.h"
+#include "memo_stats.h"
 
+class Context;
+class Object;
+class Profiler;
+
+enum class ExecutionMode { kTreeWalking, kBytecode };
+
+// Interpreters keep all of their state to themselves, so several of them can
+// run in parallel on different threads. A single interpreter must not be used
+// by two threads at once.
 class Interpreter {
 public:
-    Interpreter();
+    explicit Interpreter(ExecutionMode mode = ExecutionMode::kTreeWalking);
+    // Cancels the tasks of futures and pmap that are still running.
+    ~Interpreter();
+
     std::string Run(const std::string& input);
+    // Evaluates every top-level form of a file, which is mapped instead of
+    // read, and returns the result of the last one.
+    std::string RunFile(const std::string& path);
+    // Reads and evaluates top-level forms one at a time until the end of the
+    // stream, printing each result on its own line as soon as it is ready.
+    // Errors are thrown; the stream is left right after the failed form's
+    // last consumed token, so the caller may report it and call RunStream
+    // again to continue.
+    void RunStream(std::istream* in, std::ostream* out);
+
+    // Limits each call of Run and RunFile, and each form read by RunStream.
+    // Tasks of futures and pmap stay under the limits of the evaluation that
+    // spawned them, even after it has returned.
+    void SetLimits(const EvaluationLimits& limits);
+
+    // Returns empty object pool slabs to the system after every Run.
+    void SetTrimPools(bool trim_pools);
+
+    // Attributes time and allocations to the lambdas and builtins called from
+    // now on. Turning profiling off discards the profile.
+    void SetProfiling(bool profiling);
+    // The profile collected so far, or null if profiling is off.
+    Profiler* GetProfiler();
+
+    // Cache counters of the memoized function bound to the global variable
+    // name, or nothing if there is no such function.
+    std::optional<MemoStats> GetMemoStats(const std::string& name);
+
+private:
+    std::shared_ptr<Object> Evaluate(const std::shared_ptr<Object>& syntax_tree);
+
+    ExecutionMode mode_;
+    bool trim_pools_ = false;
+    EvaluationLimits limits_;
+    std::unique_ptr<Profiler> profiler_;
+    std::unique_ptr<Context> context_;
 };
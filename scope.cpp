@@ -1,27 +1,74 @@
 #include "scope.h"
+#include "folding.h"
 #include "functions.h"
+#include "parallel.h"
+#include "hash_table.h"
+#include "memoize.h"
+#include <bit>
+#include <unordered_map>
 
-static std::shared_ptr<Scope> current_scope;
+const ObjectPtr& Unbound() {
+    static const ObjectPtr kUnbound = std::make_shared<Function>();
+    return kUnbound;
+}
+
+// Frame
+
+ObjectPtr& Frame::Lookup(size_t depth, size_t slot) {
+    Frame* frame = this;
+    for (size_t i = 0; i < depth; ++i) {
+        frame = frame->parent_.get();
+    }
+    return frame->slots_[slot];
+}
 
-std::shared_ptr<Scope> GetCurrentScope() {
-    return current_scope;
+const std::shared_ptr<Frame>& Frame::GetParent() const {
+    return parent_;
 }
 
-void SetCurrentScope(std::shared_ptr<Scope> other) {
-    if (!other) {
-        RuntimeError("Scope error");
+void Frame::Traverse(const std::function<void(Collectable*)>& visit) {
+    for (auto& slot : slots_) {
+        VisitCollectable(slot, visit);
+    }
+    if (parent_) {
+        visit(parent_.get());
     }
-    current_scope = other;
 }
 
-void Scope::SetPreviousScope(std::shared_ptr<Scope> other) {
-    previous_scope_ = other;
+void Frame::Clear() {
+    slots_.clear();
+    parent_.reset();
 }
 
+long Frame::UseCount() const {
+    return weak_from_this().use_count();
+}
+
+std::shared_ptr<void> Frame::Hold() {
+    return shared_from_this();
+}
+
+const ObjectPtr& GetLocal(Frame* frame, const LocalAddress& address) {
+    const ObjectPtr& value = frame->Lookup(address.depth, address.slot);
+    if (value == Unbound()) {
+        throw NameError("Unknown identifier: " + address.symbol->GetName());
+    }
+    return value;
+}
+
+void SetLocal(Frame* frame, const LocalAddress& address, ObjectPtr object) {
+    ObjectPtr& value = frame->Lookup(address.depth, address.slot);
+    if (value == Unbound()) {
+        throw NameError("Unknown identifier: " + address.symbol->GetName());
+    }
+    value = std::move(object);
+}
+
+// Global scope
+
 void Scope::InitGlobalScope() {
-    registered_functions_ = {
+    std::unordered_map<std::string, ObjectPtr> builtins = {
         // list
-        {"quote", std::make_shared<QuoteFunction>()},
         {"pair?", std::make_shared<IsFunction>(IsPair)},
         {"null?", std::make_shared<IsFunction>(IsNull)},
         {"list?", std::make_shared<IsFunction>(IsCorrectList)},
@@ -33,59 +80,204 @@ void Scope::InitGlobalScope() {
         {"list-ref", std::make_shared<ListRefFunction>()},
         {"set-car!", std::make_shared<SetCarFunction>()},
         {"set-cdr!", std::make_shared<SetCdrFunction>()},
-        // integers
+        // vectors
+        {"vector?", std::make_shared<IsFunction>(IsVector)},
+        {"vector", std::make_shared<VectorFunction>()},
+        {"make-vector", std::make_shared<MakeVectorFunction>()},
+        {"vector-length", std::make_shared<VectorLengthFunction>()},
+        {"vector-ref", std::make_shared<VectorRefFunction>()},
+        {"vector-set!", std::make_shared<VectorSetFunction>()},
+        {"vector-fill!", std::make_shared<VectorFillFunction>()},
+        {"vector-copy", std::make_shared<VectorCopyFunction>()},
+        {"vector->list", std::make_shared<VectorToListFunction>()},
+        {"list->vector", std::make_shared<ListToVectorFunction>()},
+        // hash tables
+        {"hash-table?", std::make_shared<IsFunction>(IsHashTable)},
+        {"make-hash-table", std::make_shared<MakeHashTableFunction>()},
+        {"hash-table-ref", std::make_shared<HashTableRefFunction>()},
+        {"hash-table-ref/default", std::make_shared<HashTableRefDefaultFunction>()},
+        {"hash-table-set!", std::make_shared<HashTableSetFunction>()},
+        {"hash-table-delete!", std::make_shared<HashTableDeleteFunction>()},
+        {"hash-table-contains?", std::make_shared<HashTableContainsFunction>()},
+        {"hash-table-count", std::make_shared<HashTableCountFunction>()},
+        {"hash-table-keys", std::make_shared<HashTableListFunction>(HashTableListFunction::kKeys)},
+        {"hash-table-values",
+         std::make_shared<HashTableListFunction>(HashTableListFunction::kValues)},
+        {"hash-table->alist",
+         std::make_shared<HashTableListFunction>(HashTableListFunction::kEntries)},
+        {"hash-table-walk", std::make_shared<HashTableWalkFunction>()},
+        // numbers
         {"number?", std::make_shared<IsFunction>(IsNumber)},
-        {"<", std::make_shared<CompareFunction<std::less<int64_t>>>()},
-        {">", std::make_shared<CompareFunction<std::greater<int64_t>>>()},
-        {"<=", std::make_shared<CompareFunction<std::less_equal<int64_t>>>()},
-        {">=", std::make_shared<CompareFunction<std::greater_equal<int64_t>>>()},
-        {"=", std::make_shared<CompareFunction<std::equal_to<int64_t>>>()},
-        {"+", std::make_shared<ArithmeticFunction<std::plus<int64_t>>>(0)},
-        {"-", std::make_shared<ArithmeticFunction<std::minus<int64_t>>>()},
-        {"*", std::make_shared<ArithmeticFunction<std::multiplies<int64_t>>>(1)},
-        {"/", std::make_shared<ArithmeticFunction<std::divides<int64_t>>>()},
-        {"min", std::make_shared<ArithmeticFunction<Min<int64_t>>>()},
-        {"max", std::make_shared<ArithmeticFunction<Max<int64_t>>>()},
+        {"<", std::make_shared<CompareFunction<std::less<>>>()},
+        {">", std::make_shared<CompareFunction<std::greater<>>>()},
+        {"<=", std::make_shared<CompareFunction<std::less_equal<>>>()},
+        {">=", std::make_shared<CompareFunction<std::greater_equal<>>>()},
+        {"=", std::make_shared<CompareFunction<std::equal_to<>>>()},
+        {"+", std::make_shared<ArithmeticFunction<Add>>(0)},
+        {"-", std::make_shared<ArithmeticFunction<Subtract>>()},
+        {"*", std::make_shared<ArithmeticFunction<Multiply>>(1)},
+        {"/", std::make_shared<ArithmeticFunction<Divide>>()},
+        {"min", std::make_shared<ArithmeticFunction<Min>>()},
+        {"max", std::make_shared<ArithmeticFunction<Max>>()},
         {"abs", std::make_shared<AbsFunction>()},
+        // numeric vectors
+        {"f64vector?", std::make_shared<IsFunction>(IsNumericVector)},
+        {"f64vector", std::make_shared<NumericVectorFunction>()},
+        {"make-f64vector", std::make_shared<MakeNumericVectorFunction>()},
+        {"f64vector-length", std::make_shared<NumericVectorLengthFunction>()},
+        {"f64vector-ref", std::make_shared<NumericVectorRefFunction>()},
+        {"f64vector-set!", std::make_shared<NumericVectorSetFunction>()},
+        {"f64vector-sum", std::make_shared<NumericVectorSumFunction>()},
         // booleans
         {"boolean?", std::make_shared<IsFunction>(IsBoolean)},
         {"not", std::make_shared<IsFunction>(IsFalse)},
-        {"and", std::make_shared<BooleanFunction<std::logical_and<bool>>>(true, false)},
-        {"or", std::make_shared<BooleanFunction<std::logical_or<bool>>>(false, true)},
         // symbols
         {"symbol?", std::make_shared<IsFunction>(IsSymbol)},
-        {"define", std::make_shared<DefineFunction>()},
-        {"set!", std::make_shared<SetFunction>()},
-        // objects
-        {"if", std::make_shared<IfFunction>()},
-        {"lambda", std::make_shared<LambdaFunction>()},
+        // parallelism
+        {"future", std::make_shared<FutureFunction>()},
+        {"touch", std::make_shared<TouchFunction>()},
+        {"pmap", std::make_shared<PMapFunction>()},
+        // memoization
+        {"memoize", std::make_shared<MemoizeFunction>()},
+        {"memoize-stats", std::make_shared<MemoStatsFunction>()},
     };
+    for (auto& [name, function] : builtins) {
+        SymbolPtr symbol = Intern(name);
+        Cast<Function>(function)->SetName(symbol.get());
+        Define(symbol, function);
+    }
+    initialized_ = true;
+}
+
+ObjectPtr Scope::Get(const SymbolPtr& s) const {
+    return *GetSlot(s).load(std::memory_order_acquire);
+}
+
+const Scope::Slot& Scope::GetSlot(const SymbolPtr& s) const {
+    const Slot* slot = Lookup(s);
+    if (!slot) {
+        throw NameError("Unknown identifier: " + s->GetName());
+    }
+    return *slot;
 }
 
-std::shared_ptr<Scope> Scope::GetPreviousScope() {
-    return previous_scope_;
+const Scope::Slot* Scope::Lookup(const SymbolPtr& s) const {
+    Slot* slot = Find(s->GetId());
+    return (slot && slot->load(std::memory_order_acquire) != &Unbound() ? slot : nullptr);
 }
 
-ObjectPtr Scope::Get(const std::string& s) {
-    if (auto it = registered_functions_.find(s); it != registered_functions_.end()) {
-        return (*it).second;
-    } else if (previous_scope_) {
-        return previous_scope_->Get(s);
-    } else {
-        throw NameError("Unknown identifier: " + s);
+Scope::Scope() = default;
+
+Scope::~Scope() {
+    Clear();
+    ForEachBlock([](Block* block) { delete block; });
+    for (auto& directory : directories_) {
+        delete[] directory.load(std::memory_order_relaxed);
+    }
+}
+
+std::atomic<Scope::Block*>* Scope::FindBlock(size_t id, bool create) const {
+    size_t number = id / kBlockSize + 1;
+    size_t level = std::bit_width(number) - 1;
+    std::atomic<std::atomic<Block*>*>& directory = directories_[level];
+    std::atomic<Block*>* blocks = directory.load(std::memory_order_acquire);
+    if (!blocks) {
+        if (!create) {
+            return nullptr;
+        }
+        auto fresh = std::make_unique<Directory>(size_t{1} << level);
+        if (directory.compare_exchange_strong(blocks, fresh.get(), std::memory_order_acq_rel)) {
+            blocks = fresh.release();
+        }
+    }
+    return &blocks[number - (size_t{1} << level)];
+}
+
+template <class Visitor>
+void Scope::ForEachBlock(Visitor visit) const {
+    for (size_t level = 0; level < kDirectories; ++level) {
+        std::atomic<Block*>* blocks = directories_[level].load(std::memory_order_acquire);
+        if (!blocks) {
+            continue;
+        }
+        for (size_t i = 0; i < (size_t{1} << level); ++i) {
+            if (Block* block = blocks[i].load(std::memory_order_acquire)) {
+                visit(block);
+            }
+        }
     }
 }
 
-void Scope::Define(const std::string& s, ObjectPtr object) {
-    registered_functions_[s] = object;
+Scope::Slot* Scope::Find(size_t id) const {
+    std::atomic<Block*>* entry = FindBlock(id, false);
+    Block* block = (entry ? entry->load(std::memory_order_acquire) : nullptr);
+    return (block ? &(*block)[id % kBlockSize] : nullptr);
+}
+
+void Scope::Define(const SymbolPtr& s, ObjectPtr object) {
+    size_t id = s->GetId();
+    if (initialized_ && IsFoldableBuiltin(s.get())) {
+        folded_builtins_redefined_.store(true, std::memory_order_relaxed);
+    }
+    std::atomic<Block*>& slot = *FindBlock(id, true);
+    Block* block = slot.load(std::memory_order_acquire);
+    if (!block) {
+        auto fresh = std::make_unique<Block>();
+        for (Slot& fresh_slot : *fresh) {
+            fresh_slot.store(&Unbound(), std::memory_order_relaxed);
+        }
+        if (slot.compare_exchange_strong(block, fresh.get(), std::memory_order_acq_rel)) {
+            block = fresh.release();
+        }
+    }
+    Store(&(*block)[id % kBlockSize], std::move(object));
 }
 
-void Scope::Set(const std::string& s, ObjectPtr object) {
-    if (auto it = registered_functions_.find(s); it != registered_functions_.end()) {
-        (*it).second = object;
-    } else if (previous_scope_) {
-        previous_scope_->Set(s, object);
-    } else {
-        throw NameError("Unknown identifier: " + s);
+void Scope::Set(const SymbolPtr& s, ObjectPtr object) {
+    Slot* slot = Find(s->GetId());
+    if (!slot || slot->load(std::memory_order_acquire) == &Unbound()) {
+        throw NameError("Unknown identifier: " + s->GetName());
+    }
+    if (IsFoldableBuiltin(s.get())) {
+        folded_builtins_redefined_.store(true, std::memory_order_relaxed);
     }
-}
\ No newline at end of file
+    Store(slot, std::move(object));
+}
+
+void Scope::Store(Slot* slot, ObjectPtr object) {
+    const ObjectPtr* old =
+        slot->exchange(new ObjectPtr(std::move(object)), std::memory_order_acq_rel);
+    if (old == &Unbound()) {
+        return;
+    }
+    std::lock_guard lock(retired_mutex_);
+    retired_.push_back(old);
+    has_retired_.store(true, std::memory_order_relaxed);
+}
+
+void Scope::Clear() {
+    ForEachBlock([](Block* block) {
+        for (Slot& slot : *block) {
+            const ObjectPtr* value = slot.exchange(&Unbound(), std::memory_order_relaxed);
+            if (value != &Unbound()) {
+                delete value;
+            }
+        }
+    });
+    ReleaseRetired();
+}
+
+void Scope::ReleaseRetired() {
+    if (!has_retired_.load(std::memory_order_relaxed)) {
+        return;
+    }
+    std::vector<const ObjectPtr*> retired;
+    {
+        std::lock_guard lock(retired_mutex_);
+        retired.swap(retired_);
+        has_retired_.store(false, std::memory_order_relaxed);
+    }
+    for (const ObjectPtr* value : retired) {
+        delete value;
+    }
+}
@@ -1,25 +1,137 @@
 #pragma once
 
-#include <unordered_map>
-#include <string>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
 #include "object.h"
 #include "error.h"
 
+// Position of a local variable, resolved at analysis time: the frame `depth`
+// levels up from the current one and the `slot` inside it.
+struct LocalAddress {
+    SymbolPtr symbol;
+    size_t depth;
+    size_t slot;
+};
+
+// Activation frame of a lambda call. Slots hold parameters followed by the
+// variables defined in the body.
+class Frame : public Collectable, public std::enable_shared_from_this<Frame> {
+public:
+    Frame(std::vector<ObjectPtr> slots, std::shared_ptr<Frame> parent)
+        : slots_(std::move(slots)), parent_(std::move(parent)) {
+    }
+
+    ObjectPtr& Lookup(size_t depth, size_t slot);
+    const std::shared_ptr<Frame>& GetParent() const;
+
+    void Traverse(const std::function<void(Collectable*)>& visit) override;
+    void Clear() override;
+    long UseCount() const override;
+    std::shared_ptr<void> Hold() override;
+
+private:
+    std::vector<ObjectPtr> slots_;
+    std::shared_ptr<Frame> parent_;
+};
+
+// Global variables, stored in a table indexed by symbol id. The table grows
+// by blocks that never move, so parallel tasks can keep reading globals while
+// new ones are defined. Blocks are found through directories of doubling
+// size, allocated as needed too, so there is no limit on symbol ids.
+//
+// A slot points to an immutable copy of the value, and rebinding swaps the
+// pointer, so a task may read a variable while another thread rebinds it.
+// Replaced values are only freed by ReleaseRetired, once no task can still be
+// reading them.
 class Scope {
 public:
+    using Slot = std::atomic<const ObjectPtr*>;
+
+    Scope();
+    ~Scope();
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
     void InitGlobalScope();
-    void Define(const std::string& s, ObjectPtr object);
-    void Set(const std::string& s, ObjectPtr object);
-    ObjectPtr Get(const std::string& s);
-    std::shared_ptr<Scope> GetPreviousScope();
-    void SetPreviousScope(std::shared_ptr<Scope> other);
+    void Define(const SymbolPtr& s, ObjectPtr object);
+    void Set(const SymbolPtr& s, ObjectPtr object);
+    ObjectPtr Get(const SymbolPtr& s) const;
+    // Both return the slot of the variable. Slots never move, and Define and
+    // Set store into them, so a slot may be kept for as long as the scope
+    // lives (see GlobalCache).
+    const Slot& GetSlot(const SymbolPtr& s) const;
+    // Null if the variable is not defined.
+    const Slot* Lookup(const SymbolPtr& s) const;
+    // Drops the values of all variables.
+    void Clear();
+    // Frees the values replaced by Define and Set. Must only be called while
+    // no other thread reads the scope.
+    void ReleaseRetired();
+
+    // Whether a builtin that constant folding relies on was defined or set
+    // after InitGlobalScope; folded code then runs as written.
+    bool AreFoldedBuiltinsRedefined() const {
+        return folded_builtins_redefined_.load(std::memory_order_relaxed);
+    }
 
 private:
-    std::unordered_map<std::string, ObjectPtr> registered_functions_;
-    std::shared_ptr<Scope> previous_scope_;
+    static constexpr size_t kBlockSize = 256;
+    // Directory i holds 2^i blocks.
+    static constexpr size_t kDirectories = 64;
+
+    using Block = std::array<Slot, kBlockSize>;
+    using Directory = std::atomic<Block*>[];
 
-    friend void SetCurrentScope(std::shared_ptr<Scope> other);
+    // Slot of the variable, or null if no variable of its block was defined.
+    Slot* Find(size_t id) const;
+    // Entry of the directories pointing to the block of id. Creates the
+    // directory if needed and create is set, otherwise returns null.
+    std::atomic<Block*>* FindBlock(size_t id, bool create) const;
+    // Calls visit for every block allocated so far.
+    template <class Visitor>
+    void ForEachBlock(Visitor visit) const;
+    void Store(Slot* slot, ObjectPtr object);
+
+    mutable std::array<std::atomic<std::atomic<Block*>*>, kDirectories> directories_{};
+    bool initialized_ = false;
+    std::atomic<bool> folded_builtins_redefined_ = false;
+    std::mutex retired_mutex_;
+    std::vector<const ObjectPtr*> retired_;
+    std::atomic<bool> has_retired_ = false;
 };
 
-std::shared_ptr<Scope> GetCurrentScope();
-void SetCurrentScope(std::shared_ptr<Scope> other);
\ No newline at end of file
+// Inline cache of a global variable lookup, kept by the code reading the
+// variable. The slot is remembered once the variable is defined; a variable
+// stays defined until its scope is cleared as the interpreter is destroyed,
+// and rebinding stores into the same slot, so the cache never goes stale.
+// Code is analyzed for a single interpreter, so the cache is not keyed by the
+// scope.
+class GlobalCache {
+public:
+    GlobalCache() = default;
+    // Copies are only made while code is being built, before it runs.
+    GlobalCache(const GlobalCache& other) : slot_(other.slot_.load(std::memory_order_relaxed)) {
+    }
+
+    ObjectPtr Get(const Scope& globals, const SymbolPtr& name) const {
+        const Scope::Slot* slot = slot_.load(std::memory_order_acquire);
+        if (!slot) {
+            slot = &globals.GetSlot(name);
+            slot_.store(slot, std::memory_order_release);
+        }
+        return *slot->load(std::memory_order_acquire);
+    }
+
+private:
+    mutable std::atomic<const Scope::Slot*> slot_ = nullptr;
+};
+
+// Value of variables that are declared but not defined yet.
+const ObjectPtr& Unbound();
+
+const ObjectPtr& GetLocal(Frame* frame, const LocalAddress& address);
+void SetLocal(Frame* frame, const LocalAddress& address, ObjectPtr object);
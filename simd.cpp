@@ -0,0 +1,186 @@
+#include "simd.h"
+#include <algorithm>
+#include <cstddef>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SCHEME_HAS_AVX2_KERNELS 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// Operations give the scalar and, where available, the AVX2 form.
+
+struct Add {
+    static double Scalar(double lhs, double rhs) {
+        return lhs + rhs;
+    }
+#ifdef SCHEME_HAS_AVX2_KERNELS
+    __attribute__((target("avx2"))) static __m256d Vector(__m256d lhs, __m256d rhs) {
+        return _mm256_add_pd(lhs, rhs);
+    }
+#endif
+};
+
+struct Subtract {
+    static double Scalar(double lhs, double rhs) {
+        return lhs - rhs;
+    }
+#ifdef SCHEME_HAS_AVX2_KERNELS
+    __attribute__((target("avx2"))) static __m256d Vector(__m256d lhs, __m256d rhs) {
+        return _mm256_sub_pd(lhs, rhs);
+    }
+#endif
+};
+
+struct Multiply {
+    static double Scalar(double lhs, double rhs) {
+        return lhs * rhs;
+    }
+#ifdef SCHEME_HAS_AVX2_KERNELS
+    __attribute__((target("avx2"))) static __m256d Vector(__m256d lhs, __m256d rhs) {
+        return _mm256_mul_pd(lhs, rhs);
+    }
+#endif
+};
+
+struct Divide {
+    static double Scalar(double lhs, double rhs) {
+        return lhs / rhs;
+    }
+#ifdef SCHEME_HAS_AVX2_KERNELS
+    __attribute__((target("avx2"))) static __m256d Vector(__m256d lhs, __m256d rhs) {
+        return _mm256_div_pd(lhs, rhs);
+    }
+#endif
+};
+
+// min and max pick the second operand when the comparison is false, as the
+// AVX instructions do, so NaNs propagate the same way in both kernels.
+
+struct Min {
+    static double Scalar(double lhs, double rhs) {
+        return lhs < rhs ? lhs : rhs;
+    }
+#ifdef SCHEME_HAS_AVX2_KERNELS
+    __attribute__((target("avx2"))) static __m256d Vector(__m256d lhs, __m256d rhs) {
+        return _mm256_min_pd(lhs, rhs);
+    }
+#endif
+};
+
+struct Max {
+    static double Scalar(double lhs, double rhs) {
+        return lhs > rhs ? lhs : rhs;
+    }
+#ifdef SCHEME_HAS_AVX2_KERNELS
+    __attribute__((target("avx2"))) static __m256d Vector(__m256d lhs, __m256d rhs) {
+        return _mm256_max_pd(lhs, rhs);
+    }
+#endif
+};
+
+// Steps are 1 for arrays and 0 for broadcast operands.
+using Kernel = void (*)(const double* lhs, size_t lhs_step, const double* rhs, size_t rhs_step,
+                        double* out, size_t size);
+
+template <class Operation>
+void ScalarKernel(const double* lhs, size_t lhs_step, const double* rhs, size_t rhs_step,
+                  double* out, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        out[i] = Operation::Scalar(lhs[i * lhs_step], rhs[i * rhs_step]);
+    }
+}
+
+double ScalarSum(const double* values, size_t size) {
+    double sum = 0;
+    for (size_t i = 0; i < size; ++i) {
+        sum += values[i];
+    }
+    return sum;
+}
+
+#ifdef SCHEME_HAS_AVX2_KERNELS
+
+constexpr size_t kLanes = 4;
+
+template <class Operation>
+__attribute__((target("avx2"))) void Avx2Kernel(const double* lhs, size_t lhs_step,
+                                                const double* rhs, size_t rhs_step, double* out,
+                                                size_t size) {
+    __m256d lhs_broadcast = _mm256_set1_pd(lhs[0]);
+    __m256d rhs_broadcast = _mm256_set1_pd(rhs[0]);
+    size_t i = 0;
+    for (; i + kLanes <= size; i += kLanes) {
+        __m256d lhs_lanes = lhs_step ? _mm256_loadu_pd(lhs + i) : lhs_broadcast;
+        __m256d rhs_lanes = rhs_step ? _mm256_loadu_pd(rhs + i) : rhs_broadcast;
+        _mm256_storeu_pd(out + i, Operation::Vector(lhs_lanes, rhs_lanes));
+    }
+    for (; i < size; ++i) {
+        out[i] = Operation::Scalar(lhs[i * lhs_step], rhs[i * rhs_step]);
+    }
+}
+
+// Four independent accumulators hide the latency of the additions.
+__attribute__((target("avx2"))) double Avx2Sum(const double* values, size_t size) {
+    __m256d sums[4] = {_mm256_setzero_pd(), _mm256_setzero_pd(), _mm256_setzero_pd(),
+                       _mm256_setzero_pd()};
+    size_t i = 0;
+    for (; i + 4 * kLanes <= size; i += 4 * kLanes) {
+        for (size_t j = 0; j < 4; ++j) {
+            sums[j] = _mm256_add_pd(sums[j], _mm256_loadu_pd(values + i + j * kLanes));
+        }
+    }
+    __m256d total = _mm256_add_pd(_mm256_add_pd(sums[0], sums[1]), _mm256_add_pd(sums[2], sums[3]));
+    double lanes[kLanes];
+    _mm256_storeu_pd(lanes, total);
+    double sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    return sum + ScalarSum(values + i, size - i);
+}
+
+bool HasAvx2() {
+    static const bool kHasAvx2 = __builtin_cpu_supports("avx2");
+    return kHasAvx2;
+}
+
+template <class Operation>
+Kernel SelectKernel() {
+    return HasAvx2() ? Avx2Kernel<Operation> : ScalarKernel<Operation>;
+}
+
+#else
+
+template <class Operation>
+Kernel SelectKernel() {
+    return ScalarKernel<Operation>;
+}
+
+#endif
+
+Kernel GetKernel(VectorOperation operation) {
+    static const Kernel kKernels[] = {
+        SelectKernel<Add>(),    SelectKernel<Subtract>(), SelectKernel<Multiply>(),
+        SelectKernel<Divide>(), SelectKernel<Min>(),      SelectKernel<Max>(),
+    };
+    return kKernels[static_cast<size_t>(operation)];
+}
+
+}  // namespace
+
+void ApplyVectorOperation(VectorOperation operation, std::span<const double> lhs,
+                          std::span<const double> rhs, std::span<double> out) {
+    if (out.empty()) {
+        return;
+    }
+    GetKernel(operation)(lhs.data(), lhs.size() == 1 ? 0 : 1, rhs.data(), rhs.size() == 1 ? 0 : 1,
+                         out.data(), out.size());
+}
+
+double SumVector(std::span<const double> values) {
+#ifdef SCHEME_HAS_AVX2_KERNELS
+    if (HasAvx2()) {
+        return Avx2Sum(values.data(), values.size());
+    }
+#endif
+    return ScalarSum(values.data(), values.size());
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <span>
+
+// Elementwise kernels over arrays of doubles for the numeric vector type.
+// They use AVX2 when the processor has it, checked once at run time, and a
+// scalar loop otherwise.
+
+enum class VectorOperation { kAdd, kSubtract, kMultiply, kDivide, kMin, kMax };
+
+// out[i] = lhs[i] op rhs[i]. An operand of size 1 is broadcast to the size
+// of out; out may be the same array as an operand.
+void ApplyVectorOperation(VectorOperation operation, std::span<const double> lhs,
+                          std::span<const double> rhs, std::span<double> out);
+
+// Sum of the values. The vector kernel adds in a different order than the
+// scalar one, so results may differ in the last bits.
+double SumVector(std::span<const double> values);
@@ -0,0 +1,42 @@
+#include "source_file.h"
+#include <cerrno>
+#include <system_error>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::system_error(errno, std::generic_category(), "Cannot open " + path);
+    }
+    struct stat info;
+    if (fstat(fd, &info) < 0) {
+        int error = errno;
+        close(fd);
+        throw std::system_error(error, std::generic_category(), "Cannot stat " + path);
+    }
+    size_ = info.st_size;
+    // Empty files cannot be mapped; they have no contents to scan either.
+    if (size_ > 0) {
+        data_ = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data_ == MAP_FAILED) {
+            int error = errno;
+            close(fd);
+            throw std::system_error(error, std::generic_category(), "Cannot map " + path);
+        }
+        madvise(data_, size_, MADV_SEQUENTIAL);
+    }
+    close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (data_) {
+        munmap(data_, size_);
+    }
+}
+
+std::string_view MappedFile::GetContents() const {
+    return std::string_view(static_cast<const char*>(data_), size_);
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+// Read-only memory mapping of a source file, so it can be tokenized in place.
+class MappedFile {
+public:
+    // Throws std::system_error if the file cannot be opened or mapped.
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    std::string_view GetContents() const;
+
+private:
+    void* data_ = nullptr;
+    size_t size_ = 0;
+};
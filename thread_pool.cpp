@@ -0,0 +1,157 @@
+#include "thread_pool.h"
+#include <algorithm>
+
+// Pool and index of the worker running on this thread, if any.
+static thread_local ThreadPool* current_pool = nullptr;
+static thread_local size_t current_worker = 0;
+// Group of the code running on this thread, null outside of tasks.
+static thread_local ThreadPool::GroupPtr current_group;
+
+static bool IsNested(const ThreadPool::Group* group, const ThreadPool::Group* ancestor) {
+    for (; group; group = group->parent.get()) {
+        if (group == ancestor) {
+            return true;
+        }
+    }
+    return false;
+}
+
+ThreadPool::GroupScope::GroupScope(GroupPtr group) : previous_(std::move(current_group)) {
+    current_group = std::move(group);
+}
+
+ThreadPool::GroupScope::~GroupScope() {
+    current_group = std::move(previous_);
+}
+
+ThreadPool::GroupPtr ThreadPool::NewGroup() {
+    return std::make_shared<const Group>(Group{current_group});
+}
+
+bool ThreadPool::TakeFrom(std::deque<QueuedTask>* tasks, bool from_back, const Group* group,
+                          QueuedTask* task) {
+    for (size_t i = 0; i < tasks->size(); ++i) {
+        size_t index = (from_back ? tasks->size() - 1 - i : i);
+        if (!group || IsNested((*tasks)[index].group.get(), group)) {
+            *task = std::move((*tasks)[index]);
+            tasks->erase(tasks->begin() + index);
+            return true;
+        }
+    }
+    return false;
+}
+
+ThreadPool::ThreadPool(size_t workers_count) {
+    workers_count = std::max<size_t>(workers_count, 1);
+    for (size_t i = 0; i < workers_count; ++i) {
+        workers_.push_back(std::make_unique<Worker>());
+    }
+    for (size_t i = 0; i < workers_count; ++i) {
+        workers_[i]->thread = std::thread([this, i] { WorkerLoop(i); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (auto& worker : workers_) {
+        worker->thread.join();
+    }
+}
+
+// Never destroyed, so workers outlive static destructors of the program.
+ThreadPool& ThreadPool::Instance() {
+    static ThreadPool* pool = new ThreadPool(std::thread::hardware_concurrency());
+    return *pool;
+}
+
+size_t ThreadPool::GetWorkersCount() const {
+    return workers_.size();
+}
+
+void ThreadPool::Submit(Task task, GroupPtr group) {
+    QueuedTask queued{std::move(task), std::move(group)};
+    if (current_pool == this) {
+        Worker& worker = *workers_[current_worker];
+        std::lock_guard lock(worker.mutex);
+        worker.tasks.push_back(std::move(queued));
+    } else {
+        std::lock_guard lock(mutex_);
+        injected_.push_back(std::move(queued));
+    }
+    pending_.fetch_add(1);
+    // Taking the lock orders the update with a worker about to sleep.
+    { std::lock_guard lock(mutex_); }
+    wake_.notify_one();
+}
+
+bool ThreadPool::RunPendingTask(const Group* group) {
+    QueuedTask task;
+    if (!TryTake(group, &task)) {
+        return false;
+    }
+    Run(std::move(task));
+    return true;
+}
+
+void ThreadPool::Run(QueuedTask task) {
+    GroupScope scope(std::move(task.group));
+    task.task();
+}
+
+bool ThreadPool::TryTake(const Group* group, QueuedTask* task) {
+    if (pending_.load() == 0) {
+        return false;
+    }
+    if (current_pool == this) {
+        Worker& worker = *workers_[current_worker];
+        std::lock_guard lock(worker.mutex);
+        if (TakeFrom(&worker.tasks, true, group, task)) {
+            pending_.fetch_sub(1);
+            return true;
+        }
+    }
+    return TryPopInjected(group, task) ||
+           TrySteal(current_pool == this ? current_worker + 1 : 0, group, task);
+}
+
+bool ThreadPool::TryPopInjected(const Group* group, QueuedTask* task) {
+    std::lock_guard lock(mutex_);
+    if (!TakeFrom(&injected_, false, group, task)) {
+        return false;
+    }
+    pending_.fetch_sub(1);
+    return true;
+}
+
+bool ThreadPool::TrySteal(size_t first, const Group* group, QueuedTask* task) {
+    for (size_t i = 0; i < workers_.size(); ++i) {
+        Worker& victim = *workers_[(first + i) % workers_.size()];
+        std::lock_guard lock(victim.mutex);
+        if (TakeFrom(&victim.tasks, false, group, task)) {
+            pending_.fetch_sub(1);
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::WorkerLoop(size_t index) {
+    current_pool = this;
+    current_worker = index;
+    while (true) {
+        QueuedTask task;
+        if (TryTake(nullptr, &task)) {
+            Run(std::move(task));
+            continue;
+        }
+        std::unique_lock lock(mutex_);
+        wake_.wait(lock, [this] { return stopping_ || pending_.load() > 0; });
+        if (stopping_) {
+            return;
+        }
+    }
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing pool shared by all interpreters of the process. Every worker
+// has its own deque: it pushes and pops its tasks at the back, idle workers
+// steal from the front of the others' deques. Tasks submitted by threads
+// outside the pool go to a shared queue.
+//
+// Every task belongs to a group, and groups made while a task runs are
+// nested in its group, so the groups of a computation and of everything it
+// spawned form a subtree. A thread waiting for a group only helps with tasks
+// of that subtree: any other task might wait for something suspended below
+// it on the same stack, and neither could finish.
+class ThreadPool {
+public:
+    using Task = std::function<void()>;
+
+    struct Group {
+        std::shared_ptr<const Group> parent;
+    };
+    using GroupPtr = std::shared_ptr<const Group>;
+
+    // Runs code on the calling thread as part of a group, for tasks it spawns.
+    class GroupScope {
+    public:
+        explicit GroupScope(GroupPtr group);
+        ~GroupScope();
+
+        GroupScope(const GroupScope&) = delete;
+        GroupScope& operator=(const GroupScope&) = delete;
+
+    private:
+        GroupPtr previous_;
+    };
+
+    explicit ThreadPool(size_t workers_count);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Pool with one worker per hardware thread.
+    static ThreadPool& Instance();
+
+    // New group nested in the group of the task running on this thread.
+    static GroupPtr NewGroup();
+
+    void Submit(Task task, GroupPtr group);
+
+    // Runs one queued task of group or of a group nested in it on the calling
+    // thread, so that threads waiting for results help instead of blocking;
+    // returns false if there was none.
+    bool RunPendingTask(const Group* group);
+
+    size_t GetWorkersCount() const;
+
+private:
+    struct QueuedTask {
+        Task task;
+        GroupPtr group;
+    };
+
+    struct Worker {
+        std::mutex mutex;
+        std::deque<QueuedTask> tasks;
+        std::thread thread;
+    };
+
+    static void Run(QueuedTask task);
+    // Takes a task nested in group, or any task if group is null, searching
+    // from the back or the front of tasks.
+    static bool TakeFrom(std::deque<QueuedTask>* tasks, bool from_back, const Group* group,
+                         QueuedTask* task);
+
+    void WorkerLoop(size_t index);
+    // With a group, only tasks nested in it are taken.
+    bool TryTake(const Group* group, QueuedTask* task);
+    bool TryPopInjected(const Group* group, QueuedTask* task);
+    bool TrySteal(size_t first, const Group* group, QueuedTask* task);
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::deque<QueuedTask> injected_;
+    std::atomic<size_t> pending_ = 0;
+    bool stopping_ = false;
+};
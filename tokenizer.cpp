@@ -1,4 +1,5 @@
 #include <cctype>
+#include <charconv>
 #include <string>
 #include "tokenizer.h"
 #include "error.h"
@@ -15,18 +16,39 @@ bool DotToken::operator==(const DotToken &) const {
     return true;
 }
 
+bool VectorOpenToken::operator==(const VectorOpenToken &) const {
+    return true;
+}
+
+bool NumericVectorOpenToken::operator==(const NumericVectorOpenToken &) const {
+    return true;
+}
+
 bool ConstantToken::operator==(const ConstantToken &other) const {
     return value == other.value;
 }
 
-bool Tokenizer::IsEnd() const {
+bool BigConstantToken::operator==(const BigConstantToken &other) const {
+    return digits == other.digits;
+}
+
+bool RealToken::operator==(const RealToken &other) const {
+    return value == other.value;
+}
+
+bool Tokenizer::IsEnd() {
+    Fill();
     return is_end_;
 }
 
-Token Tokenizer::GetToken() const {
+const Token& Tokenizer::GetToken() {
+    Fill();
     return last_token_;
 }
 
+// Read as a symbol unless an opening bracket follows.
+static constexpr std::string_view kNumericVectorPrefix = "#f64";
+
 static inline bool IsStartSymbol(char c) {
     return (isalpha(c) || c == '<' || c == '=' || c == '>' || c == '*' || c == '/' || c == '#');
 }
@@ -35,24 +57,121 @@ static inline bool IsInnerSymbol(char c) {
     return (IsStartSymbol(c) || isdigit(c) || c == '?' || c == '!' || c == '-');
 }
 
-static ConstantToken ReadConstantToken(std::istream *in) {
-    std::string number_string;
+// Literals out of the range of int64_t are left to the parser as digits.
+static Token ParseConstantToken(std::string_view digits) {
+    int64_t value = 0;
+    auto [end, error] = std::from_chars(digits.data(), digits.data() + digits.size(), value);
+    if (error == std::errc::result_out_of_range) {
+        return BigConstantToken{digits};
+    }
+    return ConstantToken{value};
+}
+
+static Token ParseRealToken(std::string_view text) {
+    double value = 0;
+    auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (error != std::errc() || end != text.data() + text.size()) {
+        throw SyntaxError("Malformed number");
+    }
+    return RealToken{value};
+}
+
+static void ReadDigits(std::istream *in, std::string *digits) {
     while (isdigit(in->peek())) {
-        number_string += in->get();
+        *digits += in->get();
+    }
+}
+
+// Reads the fraction and exponent following the integer part of a number,
+// if any; returns whether there were some.
+static bool ReadRealSuffix(std::istream *in, std::string *number) {
+    bool is_real = false;
+    if (in->peek() == '.') {
+        in->get();
+        if (!isdigit(in->peek())) {
+            in->unget();
+            return false;
+        }
+        *number += '.';
+        ReadDigits(in, number);
+        is_real = true;
+    }
+    if (in->peek() == 'e' || in->peek() == 'E') {
+        in->get();
+        int next = in->peek();
+        if (!isdigit(next) && next != '+' && next != '-') {
+            in->unget();
+            return is_real;
+        }
+        *number += 'e';
+        if (next == '+' || next == '-') {
+            *number += in->get();
+        }
+        if (!isdigit(in->peek())) {
+            throw SyntaxError("Malformed number");
+        }
+        ReadDigits(in, number);
+        is_real = true;
+    }
+    return is_real;
+}
+
+// Same as ReadRealSuffix for a buffer: returns the end of the suffix that
+// starts at position, which is position itself if there is none.
+static size_t ScanRealSuffix(std::string_view source, size_t position) {
+    auto is_digit_at = [&source](size_t i) { return i < source.size() && isdigit(source[i]); };
+    if (position < source.size() && source[position] == '.' && is_digit_at(position + 1)) {
+        position += 2;
+        while (is_digit_at(position)) {
+            ++position;
+        }
+    }
+    if (position < source.size() && (source[position] == 'e' || source[position] == 'E')) {
+        size_t exponent = position + 1;
+        bool signed_exponent =
+            exponent < source.size() && (source[exponent] == '+' || source[exponent] == '-');
+        if (signed_exponent) {
+            ++exponent;
+        }
+        if (!is_digit_at(exponent)) {
+            if (signed_exponent) {
+                throw SyntaxError("Malformed number");
+            }
+            return position;
+        }
+        position = exponent;
+        while (is_digit_at(position)) {
+            ++position;
+        }
     }
-    return ConstantToken{std::stoi(number_string)};
+    return position;
 }
 
-static SymbolToken ReadSymbolToken(std::istream *in) {
-    std::string token_string;
-    token_string += in->get();
+static void ReadSymbol(std::istream *in, std::string *symbol) {
+    symbol->clear();
+    *symbol += in->get();
     while (IsInnerSymbol(in->peek())) {
-        token_string += in->get();
+        *symbol += in->get();
     }
-    return SymbolToken{token_string};
 }
 
 void Tokenizer::Next() {
+    pending_ = true;
+}
+
+void Tokenizer::Fill() {
+    if (!pending_) {
+        return;
+    }
+    pending_ = false;
+    if (in_) {
+        ReadFromStream();
+    } else {
+        ReadFromBuffer();
+    }
+}
+
+void Tokenizer::ReadFromStream() {
     int c;
     while (std::isspace(c = in_->peek())) {
         in_->get();
@@ -68,19 +187,41 @@ void Tokenizer::Next() {
     } else if (c == '.') {
         last_token_ = DotToken();
         in_->get();
+    } else if (c == '#') {
+        in_->get();
+        if (in_->peek() == '(') {
+            last_token_ = VectorOpenToken();
+            in_->get();
+        } else {
+            in_->unget();
+            ReadSymbol(in_, &symbol_);
+            if (symbol_ == kNumericVectorPrefix && in_->peek() == '(') {
+                last_token_ = NumericVectorOpenToken();
+                in_->get();
+            } else {
+                last_token_ = SymbolToken{symbol_};
+            }
+        }
     } else if (isdigit(c)) {
-        last_token_ = ReadConstantToken(in_);
+        symbol_.clear();
+        ReadDigits(in_, &symbol_);
+        last_token_ = ReadRealSuffix(in_, &symbol_) ? ParseRealToken(symbol_)
+                                                    : ParseConstantToken(symbol_);
     } else if (IsStartSymbol(c)) {
-        last_token_ = ReadSymbolToken(in_);
+        ReadSymbol(in_, &symbol_);
+        last_token_ = SymbolToken{symbol_};
     } else if (c == '+' || c == '-') {
         in_->get();
         int next_c = in_->peek();
         if (isdigit(next_c)) {
-            ConstantToken token = ReadConstantToken(in_);
+            // from_chars accepts a leading '-' but not '+'.
+            symbol_.clear();
             if (c == '-') {
-                token.value *= -1;
+                symbol_ += c;
             }
-            last_token_ = token;
+            ReadDigits(in_, &symbol_);
+            last_token_ = ReadRealSuffix(in_, &symbol_) ? ParseRealToken(symbol_)
+                                                        : ParseConstantToken(symbol_);
         } else {
             last_token_ = SymbolToken{(c == '+' ? "+" : "-")};
         }
@@ -89,6 +230,62 @@ void Tokenizer::Next() {
     }
 }
 
-Tokenizer::Tokenizer(std::istream *in) : is_end_(false), in_(in) {
-    Next();
+void Tokenizer::ReadFromBuffer() {
+    const char* data = source_.data();
+    size_t size = source_.size();
+    while (position_ < size && std::isspace(static_cast<unsigned char>(data[position_]))) {
+        ++position_;
+    }
+    if (position_ == size) {
+        is_end_ = true;
+        return;
+    }
+    char c = data[position_];
+    if (c == '(' || c == ')') {
+        last_token_ = BracketToken{(c == '(' ? BracketToken::OPEN : BracketToken::CLOSE)};
+        ++position_;
+    } else if (c == '\'') {
+        last_token_ = QuoteToken();
+        ++position_;
+    } else if (c == '.') {
+        last_token_ = DotToken();
+        ++position_;
+    } else if (c == '#' && position_ + 1 < size && data[position_ + 1] == '(') {
+        last_token_ = VectorOpenToken();
+        position_ += 2;
+    } else if (isdigit(c) || ((c == '+' || c == '-') && position_ + 1 < size &&
+                              isdigit(data[position_ + 1]))) {
+        // from_chars accepts a leading '-' but not '+'.
+        size_t begin = (c == '+' ? position_ + 1 : position_);
+        do {
+            ++position_;
+        } while (position_ < size && isdigit(data[position_]));
+        size_t integer_end = position_;
+        position_ = ScanRealSuffix(source_, position_);
+        std::string_view number = source_.substr(begin, position_ - begin);
+        last_token_ =
+            (position_ != integer_end ? ParseRealToken(number) : ParseConstantToken(number));
+    } else if (IsStartSymbol(c)) {
+        size_t begin = position_++;
+        while (position_ < size && IsInnerSymbol(data[position_])) {
+            ++position_;
+        }
+        std::string_view name = source_.substr(begin, position_ - begin);
+        if (name == kNumericVectorPrefix && position_ < size && data[position_] == '(') {
+            last_token_ = NumericVectorOpenToken();
+            ++position_;
+        } else {
+            last_token_ = SymbolToken{name};
+        }
+    } else if (c == '+' || c == '-') {
+        last_token_ = SymbolToken{source_.substr(position_++, 1)};
+    } else {
+        throw SyntaxError("");
+    }
+}
+
+Tokenizer::Tokenizer(std::istream *in) : is_end_(false), pending_(true), in_(in) {
+}
+
+Tokenizer::Tokenizer(std::string_view source) : is_end_(false), pending_(true), source_(source) {
 }
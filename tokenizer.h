@@ -1,11 +1,16 @@
 #pragma once
 
+#include <cstdint>
 #include <variant>
 #include <optional>
 #include <istream>
+#include <string>
+#include <string_view>
 
+// Name of the symbol. For buffer input it points into the source, for stream
+// input into the tokenizer; it stays valid until the next call to Next().
 struct SymbolToken {
-    std::string name;
+    std::string_view name;
 
     bool operator==(const SymbolToken& other) const;
 };
@@ -18,28 +23,68 @@ struct DotToken {
     bool operator==(const DotToken&) const;
 };
 
+// Opening `#(` of a vector literal; the vector is closed by BracketToken.
+struct VectorOpenToken {
+    bool operator==(const VectorOpenToken&) const;
+};
+
+// Opening `#f64(` of a numeric vector literal, closed by BracketToken.
+struct NumericVectorOpenToken {
+    bool operator==(const NumericVectorOpenToken&) const;
+};
+
 enum class BracketToken { OPEN, CLOSE };
 
 struct ConstantToken {
-    int value;
+    int64_t value;
 
     bool operator==(const ConstantToken& other) const;
 };
 
-using Token = std::variant<ConstantToken, BracketToken, SymbolToken, QuoteToken, DotToken>;
+// Integer literal that does not fit into int64_t: its optionally signed
+// digits, valid for as long as the name of a SymbolToken.
+struct BigConstantToken {
+    std::string_view digits;
+
+    bool operator==(const BigConstantToken& other) const;
+};
+
+// Decimal literal with a fraction or an exponent: 1.5, -2e10.
+struct RealToken {
+    double value;
+
+    bool operator==(const RealToken& other) const;
+};
+
+using Token = std::variant<ConstantToken, BigConstantToken, RealToken, BracketToken, SymbolToken,
+                           QuoteToken, DotToken, VectorOpenToken, NumericVectorOpenToken>;
 
 class Tokenizer {
 public:
+    // Reads the stream one character at a time.
     Tokenizer(std::istream* in);
+    // Scans a contiguous buffer without copying it; the buffer must outlive
+    // the tokenizer.
+    explicit Tokenizer(std::string_view source);
 
-    bool IsEnd() const;
+    // The next token is only read when it is asked for, so a stream is never
+    // consumed past the end of the last complete datum.
+    bool IsEnd();
 
     void Next();
 
-    Token GetToken() const;
+    const Token& GetToken();
 
 private:
+    void Fill();
+    void ReadFromStream();
+    void ReadFromBuffer();
+
     bool is_end_;
-    std::istream* in_;
+    bool pending_;
+    std::istream* in_ = nullptr;
+    std::string_view source_;
+    size_t position_ = 0;
+    std::string symbol_;
     Token last_token_;
 };
\ No newline at end of file
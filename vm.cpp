@@ -0,0 +1,178 @@
+#include "vm.h"
+#include "analyzer.h"
+#include "functions.h"
+#include "scope.h"
+#include <iterator>
+
+VirtualMachine::VirtualMachine(Context* context)
+    : context_(context), globals_(context->GetGlobals()) {
+}
+
+ObjectPtr VirtualMachine::Run(const Chunk& chunk, std::shared_ptr<Frame> frame) {
+    size_t entry_depth = frames_.size();
+    size_t entry_stack = stack_.size();
+    size_t call_depth = context_->GetCallDepth();
+    Profiler* profiler = context_->GetProfiler();
+    size_t profiler_depth = profiler ? profiler->GetDepth() : 0;
+    frames_.push_back(CallFrame{&chunk, 0, entry_stack, std::move(frame)});
+    try {
+        return Execute(entry_depth);
+    } catch (...) {
+        context_->SetCallDepth(call_depth);
+        if (profiler) {
+            profiler->Unwind(profiler_depth);
+        }
+        frames_.resize(entry_depth);
+        stack_.resize(entry_stack);
+        throw;
+    }
+}
+
+ObjectPtr VirtualMachine::Execute(size_t entry_depth) {
+    while (true) {
+        CallFrame& frame = frames_.back();
+        const Instruction& instruction = frame.chunk->GetCode()[frame.pc++];
+        switch (instruction.op) {
+            case OpCode::kConstant:
+                stack_.push_back(frame.chunk->GetConstant(instruction.arg));
+                break;
+            case OpCode::kLoadLocal:
+                stack_.push_back(
+                    GetLocal(frame.frame.get(), frame.chunk->GetLocal(instruction.arg)));
+                break;
+            case OpCode::kLoadGlobal:
+                stack_.push_back(frame.chunk->LoadGlobal(instruction.arg, *globals_));
+                break;
+            case OpCode::kDefineLocal:
+                frame.frame->Lookup(0, instruction.arg) = std::move(stack_.back());
+                stack_.back() = nullptr;
+                break;
+            case OpCode::kDefineGlobal:
+                globals_->Define(frame.chunk->GetSymbol(instruction.arg), std::move(stack_.back()));
+                stack_.back() = nullptr;
+                break;
+            case OpCode::kSetLocal:
+                SetLocal(frame.frame.get(), frame.chunk->GetLocal(instruction.arg),
+                         std::move(stack_.back()));
+                stack_.back() = nullptr;
+                break;
+            case OpCode::kSetGlobal:
+                globals_->Set(frame.chunk->GetSymbol(instruction.arg), std::move(stack_.back()));
+                stack_.back() = nullptr;
+                break;
+            case OpCode::kPop:
+                stack_.pop_back();
+                break;
+            case OpCode::kJump:
+                frame.pc = instruction.arg;
+                break;
+            case OpCode::kJumpIfFalse: {
+                bool is_false = IsFalse(stack_.back());
+                stack_.pop_back();
+                if (is_false) {
+                    frame.pc = instruction.arg;
+                }
+                break;
+            }
+            case OpCode::kJumpIfFalseOrPop:
+                if (IsFalse(stack_.back())) {
+                    frame.pc = instruction.arg;
+                } else {
+                    stack_.pop_back();
+                }
+                break;
+            case OpCode::kJumpIfTrueOrPop:
+                if (!IsFalse(stack_.back())) {
+                    frame.pc = instruction.arg;
+                } else {
+                    stack_.pop_back();
+                }
+                break;
+            case OpCode::kJumpIfRedefined:
+                if (globals_->AreFoldedBuiltinsRedefined()) {
+                    frame.pc = instruction.arg;
+                }
+                break;
+            case OpCode::kClosure:
+                stack_.push_back(
+                    MakeObject<Lambda>(frame.chunk->GetLambda(instruction.arg), frame.frame));
+                break;
+            case OpCode::kCall:
+                Call(instruction.arg);
+                break;
+            case OpCode::kTailCall:
+                TailCall(instruction.arg);
+                break;
+            case OpCode::kReturn: {
+                ObjectPtr res = std::move(stack_.back());
+                size_t base = frame.base;
+                frames_.pop_back();
+                if (frames_.size() == entry_depth) {
+                    stack_.resize(base);
+                    return res;
+                }
+                context_->LeaveCall();
+                if (Profiler* profiler = context_->GetProfiler()) {
+                    profiler->Leave();
+                }
+                // Drop the arguments together with the callee below them.
+                stack_.resize(base - 1);
+                stack_.push_back(std::move(res));
+                break;
+            }
+            case OpCode::kError:
+                throw RuntimeError(frame.chunk->GetMessage(instruction.arg));
+        }
+    }
+}
+
+void VirtualMachine::Call(uint32_t args_count) {
+    context_->CountStep();
+    size_t function_index = stack_.size() - args_count - 1;
+    const ObjectPtr& function = stack_[function_index];
+    if (!function) {
+        throw RuntimeError("Object is not a function");
+    }
+
+    if (Is<Lambda>(function)) {
+        std::shared_ptr<Lambda> lambda = As<Lambda>(function);
+        context_->EnterCall();
+        if (Profiler* profiler = context_->GetProfiler()) {
+            profiler->Enter(lambda->GetName());
+        }
+        std::vector<ObjectPtr> args(std::make_move_iterator(stack_.begin() + function_index + 1),
+                                    std::make_move_iterator(stack_.end()));
+        std::shared_ptr<Frame> frame = MakeFrame(*lambda, std::move(args));
+        // The callee stays on the stack and keeps its chunk alive during the call.
+        stack_.resize(function_index + 1);
+        frames_.push_back(
+            CallFrame{&lambda->GetCode()->GetChunk(), 0, stack_.size(), std::move(frame)});
+        context_->MaybeCollectGarbage();
+        return;
+    }
+
+    std::vector<ObjectPtr> args(std::make_move_iterator(stack_.begin() + function_index + 1),
+                                std::make_move_iterator(stack_.end()));
+    ObjectPtr res = ApplyFunction(context_, function, args);
+    stack_.resize(function_index);
+    stack_.push_back(std::move(res));
+}
+
+void VirtualMachine::TailCall(uint32_t args_count) {
+    size_t function_index = stack_.size() - args_count - 1;
+    if (!Is<Lambda>(stack_[function_index])) {
+        Call(args_count);
+        return;
+    }
+    // Move the callee and its arguments over the current frame's callee slot,
+    // then call from there as if the caller had already returned.
+    size_t target = frames_.back().base - 1;
+    std::move(stack_.begin() + function_index, stack_.end(), stack_.begin() + target);
+    stack_.resize(target + args_count + 1);
+    frames_.pop_back();
+    context_->LeaveCall();
+    if (Profiler* profiler = context_->GetProfiler()) {
+        profiler->Leave();
+    }
+    Call(args_count);
+}
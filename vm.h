@@ -0,0 +1,36 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include "bytecode.h"
+#include "object.h"
+#include "scope.h"
+#include "context.h"
+
+// Stack machine executing compiled chunks. Calls between lambdas push a frame
+// instead of recursing on the C++ stack, so recursion depth is bounded only
+// by memory and the depth limit.
+
+class VirtualMachine {
+public:
+    explicit VirtualMachine(Context* context);
+
+    ObjectPtr Run(const Chunk& chunk, std::shared_ptr<Frame> frame);
+
+private:
+    struct CallFrame {
+        const Chunk* chunk;
+        size_t pc;
+        size_t base;
+        std::shared_ptr<Frame> frame;
+    };
+
+    ObjectPtr Execute(size_t entry_depth);
+    void Call(uint32_t args_count);
+    void TailCall(uint32_t args_count);
+
+    std::vector<ObjectPtr> stack_;
+    std::vector<CallFrame> frames_;
+    Context* context_;
+    Scope* globals_;
+};